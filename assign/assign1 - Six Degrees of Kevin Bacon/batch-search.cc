@@ -0,0 +1,208 @@
+#include "batch-search.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+using namespace std;
+
+static const int kBacklog = 16;
+
+batchSearcher::batchSearcher(const imdbGraph& graph, int numWorkers, bool bidirectional,
+		const landmarkOracle *oracle) :
+	graph(graph), numWorkers(max(1, numWorkers)), bidirectional(bidirectional), oracle(oracle),
+	currentBatch(NULL), nextQuery(0), generation(0), running(0), stopping(false) {
+	states.reserve(this->numWorkers);
+	for (int i = 0; i < this->numWorkers; i++) states.emplace_back(graph);
+	for (int id = 1; id < this->numWorkers; id++) {
+		workers.push_back(thread([this, id] { worker(id); }));
+	}
+}
+
+batchSearcher::~batchSearcher() {
+	{
+		lock_guard<mutex> lg(m);
+		stopping = true;
+	}
+	batchReady.notify_all();
+	for (thread& t : workers) t.join();
+}
+
+void batchSearcher::worker(int id) {
+	unsigned int seen = 0;
+	while (true) {
+		unique_lock<mutex> ul(m);
+		batchReady.wait(ul, [this, seen] { return stopping || generation != seen; });
+		if (stopping) return;
+		seen = generation;
+		ul.unlock();
+		answerQueries(id);
+		ul.lock();
+		if (--running == 0) batchDone.notify_one();
+	}
+}
+
+void batchSearcher::answer(query& q, graphSearchState& state) {
+	auto start = chrono::steady_clock::now();
+	ostringstream oss;
+	if (!q.wellFormed) {
+		oss << "Queries should be two names separated by a tab." << endl;
+	} else {
+		path p(q.source);
+		searchStats stats;
+		if (graphSearch(graph, q.source, q.target, bidirectional, state, p, stats, oracle)) {
+			oss << p << endl;
+		} else {
+			oss << "No path between those two people could be found." << endl;
+		}
+	}
+	q.answer = oss.str();
+	auto stop = chrono::steady_clock::now();
+	q.latency = chrono::duration<double, milli>(stop - start).count();
+}
+
+/**
+ * Claims queries from the current batch and answers them until there are
+ * none left.  Each worker only ever touches its own graphSearchState, and
+ * each query is claimed by exactly one worker.
+ */
+void batchSearcher::answerQueries(int id) {
+	vector<query>& batch = *currentBatch;
+	for (size_t i = nextQuery++; i < batch.size(); i = nextQuery++) {
+		answer(batch[i], states[id]);
+	}
+}
+
+/**
+ * Hands the batch to every worker, answers queries alongside them, and waits
+ * for all of them to finish.
+ */
+void batchSearcher::runBatch(vector<query>& batch) {
+	currentBatch = &batch;
+	nextQuery = 0;
+	{
+		lock_guard<mutex> lg(m);
+		running = numWorkers - 1;
+		generation++;
+	}
+	batchReady.notify_all();
+	answerQueries(0);
+	{
+		unique_lock<mutex> ul(m);
+		batchDone.wait(ul, [this] { return running == 0; });
+	}
+}
+
+/**
+ * Returns true if infile's descriptor has more input (or end of file) ready,
+ * so reading from it won't wait.  Lines stdio has already buffered don't
+ * count, so a batch can end sooner than it needs to, but never later.
+ */
+static bool inputReady(FILE *infile) {
+	struct pollfd pfd;
+	pfd.fd = fileno(infile);
+	pfd.events = POLLIN;
+	return poll(&pfd, 1, 0) > 0;
+}
+
+/**
+ * Reads the next batch: blocks for the first query, then takes only what
+ * can be read without waiting.  Returns false once infile is exhausted,
+ * though batch may still hold the last few queries.
+ */
+bool batchSearcher::readBatch(FILE *infile, char *&line, size_t& capacity, vector<query>& batch) {
+	batch.clear();
+	do {
+		ssize_t length = getline(&line, &capacity, infile);
+		if (length == -1) return false;
+		while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r')) line[--length] = '\0';
+		if (length == 0) continue;
+		query q;
+		const char *tab = strchr(line, '\t');
+		q.wellFormed = tab != NULL;
+		if (q.wellFormed) {
+			q.source.assign(line, tab - line);
+			q.target.assign(tab + 1);
+		}
+		batch.push_back(q);
+	} while (batch.size() < kBatchSize && (batch.empty() || inputReady(infile)));
+	return true;
+}
+
+size_t batchSearcher::serve(FILE *infile, FILE *outfile) {
+	size_t numQueries = 0;
+	char *line = NULL;
+	size_t capacity = 0;
+	vector<query> batch;
+	bool more = true;
+	while (more) {
+		more = readBatch(infile, line, capacity, batch);
+		if (batch.empty()) continue;
+		runBatch(batch);
+		for (const query& q : batch) {
+			fputs(q.answer.c_str(), outfile);
+			latencies.push_back(q.latency);
+		}
+		fflush(outfile);
+		numQueries += batch.size();
+		if (ferror(outfile)) break; // nobody is listening any more
+	}
+	free(line);
+	return numQueries;
+}
+
+bool batchSearcher::serveOnPort(unsigned short port, ostream& os) {
+	int server = socket(AF_INET, SOCK_STREAM, 0);
+	if (server == -1) return false;
+	const int optval = 1;
+	setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval));
+	struct sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+	address.sin_port = htons(port);
+	if (::bind(server, (struct sockaddr *) &address, sizeof(address)) == -1 || listen(server, kBacklog) == -1) {
+		close(server);
+		return false;
+	}
+
+	// a client that hangs up early should only end its own connection
+	signal(SIGPIPE, SIG_IGN);
+	while (true) {
+		int client = accept(server, NULL, NULL);
+		if (client == -1) continue;
+		FILE *infile = fdopen(client, "r");
+		FILE *outfile = fdopen(dup(client), "w");
+		if (infile != NULL && outfile != NULL) {
+			serve(infile, outfile);
+			reportLatencies(os);
+		}
+		if (infile != NULL) fclose(infile); else close(client);
+		if (outfile != NULL) fclose(outfile);
+	}
+}
+
+static double percentile(const vector<double>& sorted, double fraction) {
+	size_t index = min(sorted.size() - 1, (size_t) (fraction * sorted.size()));
+	return sorted[index];
+}
+
+void batchSearcher::reportLatencies(ostream& os) {
+	if (latencies.empty()) return;
+	sort(latencies.begin(), latencies.end());
+	os << latencies.size() << " queries: " << fixed << setprecision(3)
+	   << "p50 " << percentile(latencies, 0.50) << " ms, "
+	   << "p90 " << percentile(latencies, 0.90) << " ms, "
+	   << "p99 " << percentile(latencies, 0.99) << " ms, "
+	   << "max " << latencies.back() << " ms" << endl;
+	latencies.clear();
+}
@@ -0,0 +1,123 @@
+#pragma once
+#include "imdb-graph.h"
+#include "landmark-oracle.h"
+#include "search-engine.h"
+#include <atomic>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+
+/**
+ * Class: batchSearcher
+ * --------------------
+ * Answers a stream of six-degrees queries against one imdbGraph, so the
+ * database is mapped and the graph is built once no matter how many queries
+ * there are.  Each query is a line holding a source and a target separated by
+ * a tab.  Each batch is the next query plus whatever others have already
+ * arrived, up to kBatchSize, so a client sending one query at a time gets each
+ * answer right away.  The queries in a batch are spread across a pool of
+ * numWorkers threads that lives as long as the batchSearcher, each of which
+ * owns a graphSearchState that's reused for every query it runs.  Answers are
+ * written in the same order the queries arrived in, each one formatted exactly
+ * as search would print it.
+ *
+ * The time spent answering every query is recorded so latency percentiles
+ * can be reported once the stream is exhausted.
+ */
+
+class batchSearcher {
+ public:
+
+/**
+ * Constructor: batchSearcher
+ * --------------------------
+ * @param graph the compact graph to search.  It must outlive the batchSearcher.
+ * @param numWorkers the number of queries that may be searched at once, at least 1.
+ * @param bidirectional true to run each query as a bidirectional search.
+ * @param oracle the landmark distances used to prune every search, or NULL.
+ */
+
+  batchSearcher(const imdbGraph& graph, int numWorkers, bool bidirectional,
+                const landmarkOracle *oracle = NULL);
+
+/**
+ * Method: serve
+ * -------------
+ * Reads queries from infile until end of file, writing each answer to outfile.
+ *
+ * @return the number of queries answered.
+ */
+
+  size_t serve(FILE *infile, FILE *outfile);
+
+/**
+ * Method: serveOnPort
+ * -------------------
+ * Listens for TCP connections on the specified port, and serves every
+ * connection (one after another) just as serve would serve stdin, reporting
+ * latencies to os after each one.  Only returns if the port can't be bound,
+ * in which case it returns false.
+ */
+
+  bool serveOnPort(unsigned short port, std::ostream& os);
+
+/**
+ * Method: reportLatencies
+ * -----------------------
+ * Publishes the number of queries answered since the last report along with
+ * the median, 90th, 99th percentile and maximum latencies, then starts over.
+ */
+
+  void reportLatencies(std::ostream& os);
+
+/**
+ * Destructor: ~batchSearcher
+ * --------------------------
+ * Stops and joins the worker threads.
+ */
+
+  ~batchSearcher();
+
+ private:
+  static const size_t kBatchSize = 256;
+
+  struct query {
+    std::string source;
+    std::string target;
+    bool wellFormed;
+    std::string answer;
+    double latency; // in milliseconds
+  };
+
+  const imdbGraph& graph;
+  int numWorkers;
+  bool bidirectional;
+  const landmarkOracle *oracle;
+  std::vector<graphSearchState> states; // one per worker
+  std::vector<double> latencies;
+
+  // per-batch job shared with the workers
+  std::vector<query> *currentBatch;
+  std::atomic<size_t> nextQuery;
+
+  // worker pool bookkeeping
+  std::vector<std::thread> workers;
+  std::mutex m;
+  std::condition_variable batchReady;
+  std::condition_variable batchDone;
+  unsigned int generation;
+  int running;
+  bool stopping;
+
+  void worker(int id);
+  void answerQueries(int id);
+  void answer(query& q, graphSearchState& state);
+  void runBatch(std::vector<query>& batch);
+  bool readBatch(FILE *infile, char *&line, size_t& capacity, std::vector<query>& batch);
+
+  batchSearcher(const batchSearcher& original) = delete;
+  batchSearcher& operator=(const batchSearcher& rhs) = delete;
+};
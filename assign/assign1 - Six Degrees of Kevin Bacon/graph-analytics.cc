@@ -0,0 +1,105 @@
+#include "graph-analytics.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+using namespace std;
+
+static const int kActorsPerClaim = 256;
+static const int kMoviesPerClaim = 1024;
+
+/**
+ * Runs work(id, first, last) over consecutive chunks of [0, count) on numThreads
+ * threads (the calling thread being thread 0), until every chunk is done.
+ */
+template <typename Work>
+static void forEachChunk(int count, int chunkSize, int numThreads, Work work) {
+	atomic<int> next(0);
+	auto run = [&](int id) {
+		for (int first = next.fetch_add(chunkSize); first < count; first = next.fetch_add(chunkSize)) {
+			work(id, first, min(count, first + chunkSize));
+		}
+	};
+	vector<thread> threads;
+	for (int id = 1; id < numThreads; id++) threads.push_back(thread(run, id));
+	run(0);
+	for (thread& t : threads) t.join();
+}
+
+void countCostars(const imdbGraph& graph, int numThreads, vector<int>& costars) {
+	int actorCount = graph.getActorCount();
+	costars.assign(actorCount, 0);
+	numThreads = max(1, numThreads);
+	vector<vector<int>> stamps(numThreads);
+	forEachChunk(actorCount, kActorsPerClaim, numThreads, [&](int id, int first, int last) {
+		vector<int>& stamp = stamps[id];
+		if (stamp.empty()) stamp.assign(actorCount, 0);
+		for (int actor = first; actor < last; actor++) {
+			stamp[actor] = actor + 1;
+			int count = 0;
+			for (const int *movie = graph.creditsBegin(actor); movie != graph.creditsEnd(actor); movie++) {
+				for (const int *costar = graph.castBegin(*movie); costar != graph.castEnd(*movie); costar++) {
+					if (stamp[*costar] == actor + 1) continue;
+					stamp[*costar] = actor + 1;
+					count++;
+				}
+			}
+			costars[actor] = count;
+		}
+	});
+}
+
+/**
+ * Follows parent pointers up to the root, halving the path as it goes.
+ * Every parent pointer points at a smaller id than the one holding it, so
+ * concurrent halving and linking can never form a cycle.
+ */
+static int findRoot(vector<atomic<int>>& parent, int actor) {
+	while (true) {
+		int up = parent[actor].load(memory_order_relaxed);
+		if (up == actor) return actor;
+		int grandparent = parent[up].load(memory_order_relaxed);
+		if (grandparent != up) parent[actor].compare_exchange_weak(up, grandparent, memory_order_relaxed);
+		actor = grandparent;
+	}
+}
+
+/**
+ * Links the roots of a's and b's trees, always hanging the larger root under
+ * the smaller one.  The link only succeeds if the larger root is still a root,
+ * so a lost race just means looking up the roots again.
+ */
+static void unite(vector<atomic<int>>& parent, int a, int b) {
+	while (true) {
+		a = findRoot(parent, a);
+		b = findRoot(parent, b);
+		if (a == b) return;
+		if (a < b) swap(a, b);
+		int expected = a;
+		if (parent[a].compare_exchange_strong(expected, b, memory_order_relaxed)) return;
+	}
+}
+
+void findComponents(const imdbGraph& graph, int numThreads, vector<int>& component) {
+	int actorCount = graph.getActorCount();
+	vector<atomic<int>> parent(actorCount);
+	for (int actor = 0; actor < actorCount; actor++) parent[actor].store(actor, memory_order_relaxed);
+	forEachChunk(graph.getMovieCount(), kMoviesPerClaim, max(1, numThreads), [&](int, int first, int last) {
+		for (int movie = first; movie < last; movie++) {
+			const int *cast = graph.castBegin(movie);
+			for (const int *costar = cast + 1; costar < graph.castEnd(movie); costar++) {
+				unite(parent, *cast, *costar);
+			}
+		}
+	});
+	component.resize(actorCount);
+	for (int actor = 0; actor < actorCount; actor++) component[actor] = findRoot(parent, actor);
+}
+
+vector<size_t> degreeHistogram(const vector<int>& degrees) {
+	vector<size_t> histogram;
+	for (int degree : degrees) {
+		if (degree >= (int) histogram.size()) histogram.resize(degree + 1, 0);
+		histogram[degree]++;
+	}
+	return histogram;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include "imdb-graph.h"
+#include <vector>
+#include <stddef.h>
+
+/**
+ * File: graph-analytics.h
+ * -----------------------
+ * Whole-graph statistics computed in a single pass over an imdbGraph, each
+ * split across a number of threads.  Every function's memory use is bounded by
+ * the size of the graph (plus one actor-sized array per thread), no matter how
+ * many costars or paths the graph holds.
+ */
+
+/**
+ * Function: countCostars
+ * ----------------------
+ * Sets costars[a] to the number of distinct actors who share at least one
+ * movie with actor a.  Threads claim small ranges of actors from a shared
+ * counter, so a few enormous hubs can't leave the other threads idle, and
+ * each thread deduplicates costars with its own stamp array: an actor-sized
+ * array where costar c has already been counted for actor a if and only if
+ * stamp[c] == a + 1, so the array never needs to be cleared.
+ */
+void countCostars(const imdbGraph& graph, int numThreads, std::vector<int>& costars);
+
+/**
+ * Function: findComponents
+ * ------------------------
+ * Partitions the actors into connected components (two actors are connected
+ * if a chain of shared movies links them) with a concurrent union-find over
+ * the movies: every movie's cast is united with its first member.  On return,
+ * component[a] is the smallest actor id in a's component, so two actors are
+ * connected if and only if their component entries are equal.
+ */
+void findComponents(const imdbGraph& graph, int numThreads, std::vector<int>& component);
+
+/**
+ * Function: degreeHistogram
+ * -------------------------
+ * Returns a histogram of the specified degrees: entry d is the number of
+ * degrees equal to d, and the histogram is just long enough to hold the
+ * largest one.
+ */
+std::vector<size_t> degreeHistogram(const std::vector<int>& degrees);
@@ -0,0 +1,113 @@
+/**
+ * File: imdb-bench.cc
+ * -------------------
+ * Measures imdb lookup throughput on the same query mix imdbtest issues:
+ * getCredits for an actor, then getCast for every one of that actor's films.
+ * The mix is run once with name lookups going through the on-disk index (if
+ * imdb-index-build has been run) and once with the index ignored, so the two
+ * can be compared, and once more through the zero-copy creditList/castList
+ * overloads.
+ *
+ * Actors are read from the file named on the command line, one per line.
+ * Without a file, every kSampleStride-th actor in the database is used.
+ */
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "imdb.h"
+using namespace std;
+
+static const int kWrongArgumentCount = 1;
+static const int kDatabaseNotFound = 2;
+static const int kActorsFileNotFound = 3;
+static const int kSampleStride = 97;
+static const int kRounds = 3;
+
+static bool readActors(const char *filename, vector<string>& actors) {
+	ifstream infile(filename);
+	if (!infile) return false;
+	string line;
+	while (getline(infile, line)) {
+		if (!line.empty()) actors.push_back(line);
+	}
+	return true;
+}
+
+static void reportQueryMix(const char *label, size_t lookups, chrono::steady_clock::time_point start) {
+	auto stop = chrono::steady_clock::now();
+	double seconds = chrono::duration<double>(stop - start).count();
+	cout << "  " << left << setw(14) << label << right << setw(10) << lookups << " lookups in "
+	     << fixed << setprecision(3) << seconds << " s (" << setprecision(0) << lookups / seconds
+	     << " lookups/s)" << endl;
+}
+
+static void runQueryMix(const char *label, const imdb& db, const vector<string>& actors) {
+	size_t lookups = 0;
+	auto start = chrono::steady_clock::now();
+	for (int round = 0; round < kRounds; round++) {
+		for (const string& player : actors) {
+			vector<film> credits;
+			db.getCredits(player, credits);
+			lookups++;
+			for (const film& movie : credits) {
+				vector<string> cast;
+				db.getCast(movie, cast);
+				lookups++;
+			}
+		}
+	}
+	reportQueryMix(label, lookups, start);
+}
+
+static void runViewQueryMix(const char *label, const imdb& db, const vector<string>& actors) {
+	size_t lookups = 0;
+	auto start = chrono::steady_clock::now();
+	for (int round = 0; round < kRounds; round++) {
+		for (const string& player : actors) {
+			creditList credits;
+			db.getCredits(player, credits);
+			lookups++;
+			for (filmView movie : credits) {
+				castList cast;
+				db.getCast(movie, cast);
+				lookups++;
+			}
+		}
+	}
+	reportQueryMix(label, lookups, start);
+}
+
+int main(int argc, char *argv[]) {
+	if (argc > 2) {
+		cerr << "Usage: " << argv[0] << " [<actors-file>]" << endl;
+		return kWrongArgumentCount;
+	}
+
+	imdb indexed(kIMDBDataDirectory);
+	imdb unindexed(kIMDBDataDirectory, false);
+	if (!indexed.good() || !unindexed.good()) {
+		cerr << "Data directory not found!  Aborting..." << endl;
+		return kDatabaseNotFound;
+	}
+
+	vector<string> actors;
+	if (argc == 2) {
+		if (!readActors(argv[1], actors)) {
+			cerr << "Can't read actors from " << argv[1] << endl;
+			return kActorsFileNotFound;
+		}
+	} else {
+		for (int actor = 0; actor < unindexed.getActorCount(); actor += kSampleStride) {
+			actors.push_back(unindexed.getActorName(actor));
+		}
+	}
+
+	cout << "Query mix over " << actors.size() << " actors, " << kRounds << " rounds:" << endl;
+	runQueryMix("binary search", unindexed, actors);
+	runQueryMix("index", indexed, actors);
+	runViewQueryMix("index+views", indexed, actors);
+	return 0;
+}
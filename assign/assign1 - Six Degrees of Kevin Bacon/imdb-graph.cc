@@ -0,0 +1,53 @@
+#include "imdb-graph.h"
+#include <algorithm>
+#include <utility>
+using namespace std;
+
+/**
+ * Maps a movie record offset (as found in an actor's credit list) back to
+ * the movie's id, given (offset, id) pairs sorted by offset.
+ */
+static int lookupMovieID(const vector<pair<int, int>>& movieIDs, int offset) {
+	auto found = lower_bound(movieIDs.begin(), movieIDs.end(), make_pair(offset, 0));
+	return found->second;
+}
+
+imdbGraph::imdbGraph(const imdb& db) : db(db), actorCount(db.getActorCount()), movieCount(db.getMovieCount()) {
+	vector<pair<int, int>> movieIDs(movieCount);
+	for (int movie = 0; movie < movieCount; movie++) {
+		movieIDs[movie] = make_pair(db.getMovieRecordOffset(movie), movie);
+	}
+	sort(movieIDs.begin(), movieIDs.end());
+
+	// actor -> movies comes straight from the actor records
+	actorStart.resize(actorCount + 1);
+	actorStart[0] = 0;
+	for (int actor = 0; actor < actorCount; actor++) {
+		int count;
+		db.getCreditOffsets(actor, count);
+		actorStart[actor + 1] = actorStart[actor] + count;
+	}
+	actorMovies.resize(actorStart[actorCount]);
+	movieStart.assign(movieCount + 1, 0);
+	for (int actor = 0; actor < actorCount; actor++) {
+		int count;
+		const int *credits = db.getCreditOffsets(actor, count);
+		for (int i = 0; i < count; i++) {
+			int movie = lookupMovieID(movieIDs, credits[i]);
+			actorMovies[actorStart[actor] + i] = movie;
+			movieStart[movie + 1]++;
+		}
+	}
+
+	// movie -> actors is the transpose, so the movie records never need decoding
+	for (int movie = 0; movie < movieCount; movie++) {
+		movieStart[movie + 1] += movieStart[movie];
+	}
+	movieActors.resize(movieStart[movieCount]);
+	vector<int> next(movieStart.begin(), movieStart.end() - 1);
+	for (int actor = 0; actor < actorCount; actor++) {
+		for (const int *movie = creditsBegin(actor); movie != creditsEnd(actor); movie++) {
+			movieActors[next[*movie]++] = actor;
+		}
+	}
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include "imdb.h"
+#include <string>
+#include <vector>
+
+/**
+ * Class: imdbGraph
+ * ----------------
+ * A compact, read-only copy of the actor/movie graph stored in an imdb.
+ * Actors and movies are identified by their dense indices into the imdb's
+ * sorted record tables, and both directions of the bipartite graph are
+ * stored in compressed sparse row (CSR) form: the credits of actor a are
+ * the movie ids in [creditsBegin(a), creditsEnd(a)), and the cast of movie m
+ * is the actor ids in [castBegin(m), castEnd(m)).
+ *
+ * Traversals over an imdbGraph never touch strings; names are only resolved
+ * (through the underlying imdb) when a result needs to be printed.  The imdb
+ * must outlive the graph.
+ */
+
+class imdbGraph {
+ public:
+
+/**
+ * Constructor: imdbGraph
+ * ----------------------
+ * Walks every actor record in the specified imdb once and builds the
+ * adjacency arrays.  The imdb is expected to have already passed its good test.
+ *
+ * @param db the imdb whose graph should be copied.
+ */
+
+  imdbGraph(const imdb& db);
+
+/**
+ * Methods: getActorCount
+ *          getMovieCount
+ * -----------------------
+ * Returns the number of actor (or movie) ids in the graph.
+ */
+
+  int getActorCount() const { return actorCount; }
+  int getMovieCount() const { return movieCount; }
+
+/**
+ * Methods: creditsBegin, creditsEnd
+ *          castBegin, castEnd
+ * ----------------------------------
+ * Returns the bounds of the contiguous run of movie ids making up an actor's
+ * credits (or the actor ids making up a movie's cast).
+ */
+
+  const int *creditsBegin(int actor) const { return actorMovies.data() + actorStart[actor]; }
+  const int *creditsEnd(int actor) const { return actorMovies.data() + actorStart[actor + 1]; }
+  const int *castBegin(int movie) const { return movieActors.data() + movieStart[movie]; }
+  const int *castEnd(int movie) const { return movieActors.data() + movieStart[movie + 1]; }
+
+/**
+ * Method: findActor
+ * -----------------
+ * Returns the id of the specified actor/actress, or -1 if there isn't one.
+ */
+
+  int findActor(const std::string& player) const { return db.findActor(player); }
+
+/**
+ * Methods: getActorName
+ *          getMovie
+ *          getMovieYear
+ * ----------------------
+ * Resolves an actor id to a name (or a movie id to a film) by way of
+ * the underlying imdb.
+ */
+
+  std::string getActorName(int actor) const { return db.getActorName(actor); }
+  film getMovie(int movie) const { return db.getMovie(movie); }
+  int getMovieYear(int movie) const { return db.getMovieView(movie).year; }
+
+ private:
+  const imdb& db;
+  int actorCount;
+  int movieCount;
+  std::vector<int> actorStart;
+  std::vector<int> actorMovies;
+  std::vector<int> movieStart;
+  std::vector<int> movieActors;
+
+  imdbGraph(const imdbGraph& original) = delete;
+  imdbGraph& operator=(const imdbGraph& rhs) = delete;
+};
@@ -0,0 +1,72 @@
+/**
+ * File: imdb-index-build.cc
+ * -------------------------
+ * Builds the actorindex and movieindex files that let imdb look up
+ * actors and movies by name in constant time.  The index files are written
+ * into the same directory as the actordata and moviedata files they index,
+ * and need to be rebuilt whenever those files change (imdb ignores an index
+ * built from a data file of a different size).
+ */
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <string.h>
+#include <sys/stat.h>
+#include "imdb.h"
+#include "imdb-index.h"
+using namespace std;
+
+static const int kWrongArgumentCount = 1;
+static const int kDatabaseNotFound = 2;
+static const int kIndexNotWritten = 3;
+
+static uint64_t fileSize(const string& fileName) {
+	struct stat stats;
+	if (stat(fileName.c_str(), &stats) == -1) return 0;
+	return stats.st_size;
+}
+
+static bool buildIndex(const string& fileName, const vector<uint64_t>& hashes, uint64_t dataFileSize) {
+	auto start = chrono::steady_clock::now();
+	bool written = writeIndex(fileName, hashes, dataFileSize);
+	auto stop = chrono::steady_clock::now();
+	if (!written) {
+		cerr << "Couldn't write " << fileName << "." << endl;
+		return false;
+	}
+	cout << "Wrote " << fileName << " (" << hashes.size() << " keys, " << fileSize(fileName) << " bytes) in "
+	     << fixed << setprecision(1) << chrono::duration<double, milli>(stop - start).count() << " ms." << endl;
+	return true;
+}
+
+int main(int argc, char *argv[]) {
+	if (argc > 2) {
+		cerr << "Usage: " << argv[0] << " [<data-directory>]" << endl;
+		return kWrongArgumentCount;
+	}
+	string directory = argc == 2 ? argv[1] : kIMDBDataDirectory;
+	imdb db(directory, false);
+	if (!db.good()) {
+		cerr << "Data directory not found!  Aborting..." << endl;
+		return kDatabaseNotFound;
+	}
+
+	vector<uint64_t> actorHashes(db.getActorCount());
+	for (int actor = 0; actor < db.getActorCount(); actor++) {
+		const char *name = db.getActorName(actor);
+		actorHashes[actor] = actorKeyHash(name, strlen(name));
+	}
+	vector<uint64_t> movieHashes(db.getMovieCount());
+	for (int movie = 0; movie < db.getMovieCount(); movie++) {
+		film f = db.getMovie(movie);
+		movieHashes[movie] = movieKeyHash(f.title.c_str(), f.title.size(), f.year);
+	}
+
+	if (!buildIndex(directory + "/" + kActorIndexFileName, actorHashes, fileSize(directory + "/actordata")) ||
+			!buildIndex(directory + "/" + kMovieIndexFileName, movieHashes, fileSize(directory + "/moviedata"))) {
+		return kIndexNotWritten;
+	}
+	return 0;
+}
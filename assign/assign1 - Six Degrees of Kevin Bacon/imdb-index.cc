@@ -0,0 +1,114 @@
+#include "imdb-index.h"
+#include <stdio.h>
+#include <algorithm>
+using namespace std;
+
+static const uint32_t kKeysPerBucket = 4;
+static const uint32_t kMaxSeed = 1 << 24;
+static const uint64_t kHashBasis = 0xcbf29ce484222325ULL;
+
+/**
+ * Final mixing step from MurmurHash3, so that every bit of the
+ * result depends on every bit of the (FNV-1a) key hash.
+ */
+static uint64_t mix(uint64_t h) {
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+/**
+ * FNV-1a over the specified bytes, continuing from a previous hash value
+ * so that a key can be hashed in pieces.
+ */
+static uint64_t hashBytes(uint64_t hash, const char *bytes, size_t length) {
+	for (size_t i = 0; i < length; i++) {
+		hash ^= (unsigned char) bytes[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+static uint32_t indexBucket(uint64_t hash, uint32_t bucketCount) {
+	return mix(hash) % bucketCount;
+}
+
+static uint32_t indexSlot(uint64_t hash, uint32_t seed, uint32_t slotCount) {
+	return mix(hash + (seed + 1) * 0x9e3779b97f4a7c15ULL) % slotCount;
+}
+
+uint64_t actorKeyHash(const char *name, size_t length) {
+	return hashBytes(kHashBasis, name, length);
+}
+
+uint64_t movieKeyHash(const char *title, size_t length, int year) {
+	// the same bytes the movie record starts with: title, '\0', then the year byte
+	const char suffix[2] = {'\0', (char) (year - 1900)};
+	return hashBytes(hashBytes(kHashBasis, title, length), suffix, sizeof(suffix));
+}
+
+int32_t indexLookup(const imdbIndexHeader *index, uint64_t hash) {
+	const uint32_t *seeds = (const uint32_t *) (index + 1);
+	const int32_t *slots = (const int32_t *) (seeds + index->bucketCount);
+	uint32_t seed = seeds[indexBucket(hash, index->bucketCount)];
+	return slots[indexSlot(hash, seed, index->slotCount)];
+}
+
+/**
+ * Searches for the smallest seed that sends every key in the bucket to a
+ * distinct, still-free slot, and claims those slots.  Returns false if no
+ * such seed exists (which only happens if two keys share a hash).
+ */
+static bool placeBucket(const vector<uint64_t>& hashes, const vector<uint32_t>& keys,
+		vector<int32_t>& slots, uint32_t& seed) {
+	vector<uint32_t> chosen(keys.size());
+	for (seed = 0; seed < kMaxSeed; seed++) {
+		bool fits = true;
+		for (size_t i = 0; i < keys.size() && fits; i++) {
+			chosen[i] = indexSlot(hashes[keys[i]], seed, slots.size());
+			fits = slots[chosen[i]] == kEmptySlot && find(chosen.begin(), chosen.begin() + i, chosen[i]) == chosen.begin() + i;
+		}
+		if (!fits) continue;
+		for (size_t i = 0; i < keys.size(); i++) slots[chosen[i]] = keys[i];
+		return true;
+	}
+	return false;
+}
+
+bool writeIndex(const string& fileName, const vector<uint64_t>& hashes, uint64_t dataFileSize) {
+	imdbIndexHeader header;
+	header.magic = kIndexMagic;
+	header.keyCount = hashes.size();
+	header.bucketCount = max<uint32_t>(1, header.keyCount / kKeysPerBucket);
+	header.slotCount = header.keyCount + header.keyCount / 8 + 1;
+	header.dataFileSize = dataFileSize;
+
+	vector<vector<uint32_t>> buckets(header.bucketCount);
+	for (uint32_t key = 0; key < header.keyCount; key++) {
+		buckets[indexBucket(hashes[key], header.bucketCount)].push_back(key);
+	}
+
+	// place the biggest buckets first, while the table is still mostly empty
+	vector<uint32_t> order(header.bucketCount);
+	for (uint32_t i = 0; i < header.bucketCount; i++) order[i] = i;
+	sort(order.begin(), order.end(), [&buckets](uint32_t a, uint32_t b) {
+		return buckets[a].size() > buckets[b].size();
+	});
+
+	vector<uint32_t> seeds(header.bucketCount, 0);
+	vector<int32_t> slots(header.slotCount, kEmptySlot);
+	for (uint32_t bucket : order) {
+		if (buckets[bucket].empty()) break;
+		if (!placeBucket(hashes, buckets[bucket], slots, seeds[bucket])) return false;
+	}
+
+	FILE *outfile = fopen(fileName.c_str(), "wb");
+	if (outfile == NULL) return false;
+	bool written = fwrite(&header, sizeof(header), 1, outfile) == 1 &&
+		fwrite(seeds.data(), sizeof(uint32_t), seeds.size(), outfile) == seeds.size() &&
+		fwrite(slots.data(), sizeof(int32_t), slots.size(), outfile) == slots.size();
+	return fclose(outfile) == 0 && written;
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * File: imdb-index.h
+ * ------------------
+ * Defines the on-disk index files (actorindex and movieindex) that
+ * live next to actordata and moviedata.  Each one is a perfect hash table from
+ * a name to the index of its record in the sorted record table, built with the
+ * hash-and-displace scheme: every key hashes to a bucket, every bucket stores
+ * the seed that sends all of its keys to distinct slots, and every slot stores
+ * a record index (or kEmptySlot).  A lookup is therefore two hashes and one
+ * string compare against the record to confirm the key was really present.
+ *
+ * Layout: an imdbIndexHeader, then bucketCount uint32_t seeds, then slotCount
+ * int32_t slots.
+ */
+
+static const char *const kActorIndexFileName = "actorindex";
+static const char *const kMovieIndexFileName = "movieindex";
+static const uint32_t kIndexMagic = 0x31584449; // "IDX1"
+static const int32_t kEmptySlot = -1;
+
+struct imdbIndexHeader {
+  uint32_t magic;
+  uint32_t keyCount;
+  uint32_t bucketCount;
+  uint32_t slotCount;
+  uint64_t dataFileSize; // size of the data file the index was built from, to detect stale indices
+};
+
+/**
+ * Functions: actorKeyHash
+ *            movieKeyHash
+ * -----------------------
+ * Hash an actor's name, or a movie's title and year, the same way the
+ * index builder does.  The result is what gets passed to indexLookup.
+ */
+uint64_t actorKeyHash(const char *name, size_t length);
+uint64_t movieKeyHash(const char *title, size_t length, int year);
+
+/**
+ * Function: indexLookup
+ * ---------------------
+ * Returns the record index stored in the slot the specified key hash maps to,
+ * or kEmptySlot.  Because every possible key maps to some slot, the caller
+ * must still confirm that the record really has the key being searched for.
+ *
+ * @param index the address of a mapped index file, starting with its header.
+ * @param hash the actorKeyHash or movieKeyHash of the key being searched for.
+ */
+int32_t indexLookup(const imdbIndexHeader *index, uint64_t hash);
+
+/**
+ * Function: writeIndex
+ * --------------------
+ * Builds a perfect hash table over the specified key hashes (the i-th hash
+ * belonging to record i) and writes it to the specified file.  Returns false
+ * if the file couldn't be written or two keys hashed identically.
+ *
+ * @param fileName the index file to create or overwrite.
+ * @param hashes the indexHash of every record's key, in record order.
+ * @param dataFileSize the size of the data file the records came from.
+ * @return true if and only if the index was written successfully.
+ */
+bool writeIndex(const std::string& fileName, const std::vector<uint64_t>& hashes, uint64_t dataFileSize);
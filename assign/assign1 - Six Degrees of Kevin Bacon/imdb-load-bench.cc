@@ -0,0 +1,127 @@
+/**
+ * File: imdb-load-bench.cc
+ * ------------------------
+ * Measures what each imdb loading policy costs at startup and what it buys
+ * once queries start arriving.  For every policy, the data and index files are
+ * first evicted from the page cache (with posix_fadvise, which only drops
+ * pages nobody else has mapped or dirtied, so run it on an otherwise idle
+ * data directory), and then three things are timed:
+ *
+ *     open    constructing the imdb
+ *     cold    the first pass of the query mix, which takes whatever page faults are left
+ *     warm    a second pass of the same query mix, with everything resident
+ *
+ * The query mix is the one imdb-bench uses: getCredits for an actor, then
+ * getCast for every one of that actor's films, through the zero-copy overloads.
+ * Policies to compare can be named on the command line (in the form
+ * search -m accepts); otherwise a standard set is run.
+ */
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "imdb.h"
+using namespace std;
+
+static const int kWrongArgumentCount = 1;
+static const int kDatabaseNotFound = 2;
+static const int kSampleStride = 97;
+static const int kTrials = 3;
+static const char *const kDataFileNames[] = {"actordata", "moviedata", kActorIndexFileName, kMovieIndexFileName};
+
+static const unsigned int kDefaultPolicies[] = {
+	kLoadLazy,
+	kLoadRandom,
+	kLoadWillNeed,
+	kLoadPopulate,
+	kLoadHugePages,
+	kLoadWarmUp,
+	kLoadRandom | kLoadWarmUp,
+	kLoadPopulate | kLoadHugePages,
+};
+
+static void evictFromPageCache(const string& directory) {
+	for (const char *name : kDataFileNames) {
+		int fd = open((directory + "/" + name).c_str(), O_RDONLY);
+		if (fd == -1) continue;
+		fdatasync(fd);
+		posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+		close(fd);
+	}
+}
+
+static size_t runQueryMix(const imdb& db) {
+	size_t lookups = 0;
+	for (int actor = 0; actor < db.getActorCount(); actor += kSampleStride) {
+		creditList credits;
+		db.getCredits(db.getActorName(actor), credits);
+		lookups++;
+		for (filmView movie : credits) {
+			castList cast;
+			db.getCast(movie, cast);
+			lookups++;
+		}
+	}
+	return lookups;
+}
+
+static double millisecondsSince(chrono::steady_clock::time_point start) {
+	return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * Runs kTrials cold starts under the specified policy and reports the best
+ * of each measurement, since noise only ever makes things slower.
+ */
+static bool measurePolicy(const string& directory, unsigned int policy) {
+	double open = 0, cold = 0, warm = 0;
+	size_t lookups = 0;
+	for (int trial = 0; trial < kTrials; trial++) {
+		evictFromPageCache(directory);
+		auto start = chrono::steady_clock::now();
+		imdb db(directory, true, policy);
+		double openTime = millisecondsSince(start);
+		if (!db.good()) return false;
+		start = chrono::steady_clock::now();
+		lookups = runQueryMix(db);
+		double coldTime = millisecondsSince(start);
+		start = chrono::steady_clock::now();
+		runQueryMix(db);
+		double warmTime = millisecondsSince(start);
+		if (trial == 0 || openTime < open) open = openTime;
+		if (trial == 0 || coldTime < cold) cold = coldTime;
+		if (trial == 0 || warmTime < warm) warm = warmTime;
+	}
+	cout << "  " << left << setw(26) << loadPolicyName(policy) << right << fixed << setprecision(2)
+	     << setw(10) << open << setw(10) << cold << setw(10) << warm
+	     << setw(12) << 1000 * cold / lookups << setw(12) << 1000 * warm / lookups << endl;
+	return true;
+}
+
+int main(int argc, char *argv[]) {
+	vector<unsigned int> policies;
+	for (int i = 1; i < argc; i++) {
+		unsigned int policy;
+		if (!parseLoadPolicy(argv[i], policy)) {
+			cerr << "Usage: " << argv[0] << " [<policy> ...]" << endl;
+			cerr << "  where a policy is a comma-separated list of: lazy populate willneed hugepages random warmup" << endl;
+			return kWrongArgumentCount;
+		}
+		policies.push_back(policy);
+	}
+	if (policies.empty()) policies.assign(begin(kDefaultPolicies), end(kDefaultPolicies));
+
+	cout << "Best of " << kTrials << " cold starts per policy (times in ms, per-lookup times in us):" << endl;
+	cout << "  " << left << setw(26) << "policy" << right << setw(10) << "open" << setw(10) << "cold"
+	     << setw(10) << "warm" << setw(12) << "cold/query" << setw(12) << "warm/query" << endl;
+	for (unsigned int policy : policies) {
+		if (!measurePolicy(kIMDBDataDirectory, policy)) {
+			cerr << "Data directory not found!  Aborting..." << endl;
+			return kDatabaseNotFound;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,144 @@
+/**
+ * File: imdb-stats.cc
+ * -------------------
+ * Prints whole-database statistics: how many costars every actor has (with the
+ * best-connected actors listed by name), histograms of credits per actor, cast
+ * size per movie and costars per actor, and the sizes of the connected
+ * components.  Everything is computed over the compact graph in one parallel
+ * pass per statistic, rather than by asking imdb about one actor at a time.
+ *
+ * Histograms are printed with power-of-two buckets, so a bucket labeled 8-15
+ * counts the actors (or movies) with anywhere from 8 to 15 credits (or cast members).
+ */
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <unistd.h>
+#include <stdlib.h>
+#include "imdb.h"
+#include "imdb-graph.h"
+#include "graph-analytics.h"
+using namespace std;
+
+static const int kWrongArgumentCount = 1;
+static const int kDatabaseNotFound = 2;
+static const int kDefaultTopCount = 10;
+
+static void printUsage(const char *progname) {
+	cerr << "Usage: " << progname << " [-j <threads>] [-k <top-count>]" << endl;
+}
+
+static double millisecondsSince(chrono::steady_clock::time_point start) {
+	return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+static void printHistogram(const string& label, const vector<size_t>& histogram) {
+	cout << label << ":" << endl;
+	for (size_t low = 0, high = 0; low < histogram.size(); low = high + 1, high = 2 * low - 1) {
+		size_t count = 0;
+		for (size_t degree = low; degree <= high && degree < histogram.size(); degree++) {
+			count += histogram[degree];
+		}
+		if (count == 0) continue;
+		string range = low == high ? to_string(low) : to_string(low) + "-" + to_string(high);
+		cout << "  " << setw(13) << range << setw(12) << count << endl;
+	}
+}
+
+static void printTopActors(const imdbGraph& graph, const vector<int>& costars, int topCount) {
+	vector<int> actors(graph.getActorCount());
+	for (int actor = 0; actor < graph.getActorCount(); actor++) actors[actor] = actor;
+	topCount = min(topCount, (int) actors.size());
+	partial_sort(actors.begin(), actors.begin() + topCount, actors.end(), [&](int a, int b) {
+		return costars[a] > costars[b] || (costars[a] == costars[b] && a < b);
+	});
+	cout << "Most costars:" << endl;
+	for (int i = 0; i < topCount; i++) {
+		cout << "  " << setw(10) << costars[actors[i]] << "  " << graph.getActorName(actors[i]) << endl;
+	}
+}
+
+static void printComponents(const vector<int>& component, int topCount) {
+	vector<int> sizes(component.size(), 0);
+	for (int root : component) sizes[root]++;
+	sizes.erase(remove(sizes.begin(), sizes.end(), 0), sizes.end());
+	sort(sizes.begin(), sizes.end(), greater<int>());
+	size_t singletons = count(sizes.begin(), sizes.end(), 1);
+	cout << sizes.size() << " connected components (" << singletons << " of them a single actor)." << endl;
+	cout << "Largest components:" << endl;
+	for (int i = 0; i < topCount && i < (int) sizes.size(); i++) {
+		cout << "  " << setw(10) << sizes[i] << (sizes[i] == 1 ? " actor" : " actors") << endl;
+	}
+}
+
+int main(int argc, char *argv[]) {
+	int numThreads = max(1, (int) thread::hardware_concurrency());
+	int topCount = kDefaultTopCount;
+	int opt;
+	while ((opt = getopt(argc, argv, "j:k:")) != -1) {
+		if ((opt == 'j' && (numThreads = atoi(optarg)) < 1) ||
+				(opt == 'k' && (topCount = atoi(optarg)) < 1) || (opt != 'j' && opt != 'k')) {
+			printUsage(argv[0]);
+			return kWrongArgumentCount;
+		}
+	}
+	if (optind != argc) {
+		printUsage(argv[0]);
+		return kWrongArgumentCount;
+	}
+	imdb db(kIMDBDataDirectory);
+	if (!db.good()) {
+		cerr << "Data directory not found!  Aborting..." << endl;
+		return kDatabaseNotFound;
+	}
+
+	auto start = chrono::steady_clock::now();
+	imdbGraph graph(db);
+	double buildTime = millisecondsSince(start);
+
+	vector<int> credits(graph.getActorCount());
+	for (int actor = 0; actor < graph.getActorCount(); actor++) {
+		credits[actor] = graph.creditsEnd(actor) - graph.creditsBegin(actor);
+	}
+	vector<int> castSizes(graph.getMovieCount());
+	for (int movie = 0; movie < graph.getMovieCount(); movie++) {
+		castSizes[movie] = graph.castEnd(movie) - graph.castBegin(movie);
+	}
+
+	start = chrono::steady_clock::now();
+	vector<int> costars;
+	countCostars(graph, numThreads, costars);
+	double costarTime = millisecondsSince(start);
+
+	start = chrono::steady_clock::now();
+	vector<int> component;
+	findComponents(graph, numThreads, component);
+	double componentTime = millisecondsSince(start);
+
+	size_t totalCredits = 0, totalCostars = 0;
+	for (int count : credits) totalCredits += count;
+	for (int count : costars) totalCostars += count;
+	cout << graph.getActorCount() << " actors, " << graph.getMovieCount() << " movies, "
+	     << totalCredits << " credits." << endl;
+	cout << "Mean costars per actor: " << fixed << setprecision(1)
+	     << (double) totalCostars / max(1, graph.getActorCount()) << endl << endl;
+	printTopActors(graph, costars, topCount);
+	cout << endl;
+	printHistogram("Credits per actor", degreeHistogram(credits));
+	cout << endl;
+	printHistogram("Cast size per movie", degreeHistogram(castSizes));
+	cout << endl;
+	printHistogram("Costars per actor", degreeHistogram(costars));
+	cout << endl;
+	printComponents(component, topCount);
+	cout << endl;
+
+	cout << "Graph built in " << setprecision(1) << buildTime << " ms; costars counted in " << costarTime
+	     << " ms and components found in " << componentTime << " ms with " << numThreads
+	     << (numThreads == 1 ? " thread." : " threads.") << endl;
+	return 0;
+}
@@ -1,6 +1,7 @@
 #pragma once
 #include <vector>
 #include <string>
+#include <string_view>
 #include <iostream>
 
 const std::string kIMDBDataDirectory("./slink/");
@@ -46,3 +47,33 @@ struct film {
   }
 };
 
+/**
+ * Convenience struct: filmView
+ * ----------------------------
+ * The same as a film, except that the title is a std::string_view, typically
+ * pointing straight into an imdb's read-only data file.  filmViews are cheap to
+ * copy and never allocate, but are only valid for as long as whatever their
+ * titles point into.  operator== and operator< order filmViews exactly the
+ * way the film versions order films, and toFilm makes a deep copy.
+ */
+struct filmView {
+
+  std::string_view title;
+  int year;
+
+  filmView() : year(0) {}
+  filmView(std::string_view title, int year) : title(title), year(year) {}
+  filmView(const film& movie) : title(movie.title), year(movie.year) {}
+
+  film toFilm() const { return film {std::string(title), year}; }
+
+  bool operator==(const filmView& rhs) const {
+    return this->title == rhs.title && (this->year == rhs.year);
+  }
+
+  bool operator<(const filmView& rhs) const {
+    return
+      (this->title < rhs.title) ||
+      (this->title == rhs.title && this->year < rhs.year);
+  }
+};
@@ -14,11 +14,26 @@ using namespace std;
 
 const char *const imdb::kActorFileName = "actordata";
 const char *const imdb::kMovieFileName = "moviedata";
-imdb::imdb(const string& directory) {
+imdb::imdb(const string& directory, bool useIndex, unsigned int loadPolicy) {
 	const string actorFileName = directory + "/" + kActorFileName;
 	const string movieFileName = directory + "/" + kMovieFileName;  
-	actorFile = acquireFileMap(actorFileName, actorInfo);
-	movieFile = acquireFileMap(movieFileName, movieInfo);
+	actorFile = acquireFileMap(actorFileName, actorInfo, loadPolicy);
+	movieFile = acquireFileMap(movieFileName, movieInfo, loadPolicy);
+	actorIndex = movieIndex = NULL;
+	actorIndexInfo.fd = movieIndexInfo.fd = -1;
+	actorIndexInfo.fileMap = movieIndexInfo.fileMap = NULL;
+	if (useIndex && good()) {
+		actorIndex = acquireIndex(directory + "/" + kActorIndexFileName, actorIndexInfo, actorInfo, loadPolicy);
+		movieIndex = acquireIndex(directory + "/" + kMovieIndexFileName, movieIndexInfo, movieInfo, loadPolicy);
+		if (actorIndex != NULL && actorIndex->keyCount != (uint32_t) getActorCount()) actorIndex = NULL;
+		if (movieIndex != NULL && movieIndex->keyCount != (uint32_t) getMovieCount()) movieIndex = NULL;
+	}
+	if ((loadPolicy & kLoadWarmUp) && good()) {
+		warmUp(actorFile, (getActorCount() + 1) * sizeof(int));
+		warmUp(movieFile, (getMovieCount() + 1) * sizeof(int));
+		if (actorIndex != NULL) warmUp(actorIndex, actorIndexInfo.fileSize);
+		if (movieIndex != NULL) warmUp(movieIndex, movieIndexInfo.fileSize);
+	}
 }
 
 bool imdb::good() const {
@@ -29,6 +44,8 @@ bool imdb::good() const {
 imdb::~imdb() {
 	releaseFileMap(actorInfo);
 	releaseFileMap(movieInfo);
+	releaseFileMap(actorIndexInfo);
+	releaseFileMap(movieIndexInfo);
 }
 
 // template<class ForwardIt, class T, class Compare=std::less<> >
@@ -39,90 +56,251 @@ imdb::~imdb() {
 // This is stricter than lower_bound requirement (see above)
 
 bool imdb::getCredits(const string& player, vector<film>& films) const {
+	int actor = findActor(player);
+	if (actor == -1) return false;
+	int count;
+	const int *credits = getCreditOffsets(actor, count);
+	for (int i = 0; i < count; i++) {
+		char *movie_pointer = (char *)movieFile + credits[i];
+		film tmp;
+		tmp.title = movie_pointer;
+		movie_pointer += tmp.title.size() + 1;
+		tmp.year = 1900 + *(unsigned char *)movie_pointer;
+		films.push_back(tmp);
+	}
+	return true;
+}
+
+bool imdb::getCast(const film& movie, vector<string>& players) const { 	
+	int index = findMovie(movie);
+	if (index == -1) return false;
+	int count;
+	const int *cast = getCastOffsets(index, count);
+	for (int i = 0; i < count; i++) {
+		char *actor_pointer = (char *)actorFile + cast[i];
+		players.push_back(actor_pointer);
+	}
+	return true;
+}
+
+bool imdb::getCredits(string_view player, creditList& credits) const {
+	credits = creditList();
+	int actor = findActor(player);
+	if (actor == -1) return false;
+	credits.movieFile = (const char *)movieFile;
+	credits.offsets = getCreditOffsets(actor, credits.count);
+	return true;
+}
+
+bool imdb::getCast(const filmView& movie, castList& cast) const {
+	cast = castList();
+	int index = findMovie(movie);
+	if (index == -1) return false;
+	cast.actorFile = (const char *)actorFile;
+	cast.offsets = getCastOffsets(index, cast.count);
+	return true;
+}
+
+int imdb::getActorCount() const {
+	return *(int *) actorFile;
+}
+
+int imdb::getMovieCount() const {
+	return *(int *) movieFile;
+}
+
+int imdb::findActor(string_view player) const {
+	if (actorIndex != NULL) {
+		int actor = indexLookup(actorIndex, actorKeyHash(player.data(), player.size()));
+		if (actor == kEmptySlot || player != getActorName(actor)) return -1;
+		return actor;
+	}
 	int count = *(int *) actorFile;
 	int *start = ((int *) actorFile) + 1;
-	int *offset = lower_bound(start, start + count, player, [this](const int offset, string player) -> bool {
-									string targ = ((char *)actorFile) + offset;
-									return targ < player;
+	int *offset = lower_bound(start, start + count, player, [this](const int offset, string_view player) -> bool {
+									return string_view((char *)actorFile + offset) < player;
 									});
-	char *info_pointer = ((char*)actorFile) + (*offset);
-	string actor = info_pointer;
-	if (actor == player) {
-		size_t size = player.size() + 1;
-		if ((size & 1) == 1){ // even
-			size += 1;
-		}
-		info_pointer += size;
-		short films_count = *(short *)info_pointer;
-		info_pointer += 2;
-		if (((size + 2) & 3) > 0) {
-			info_pointer += 2;
-		}
-
-		while (films_count > 0) {
-			int film_offset = *(int *)info_pointer;
-			char *movie_pointer = (char *)movieFile + film_offset;
-			film tmp;
-			tmp.title = movie_pointer;
-			movie_pointer += tmp.title.size() + 1;
-			tmp.year = 1900 + *(unsigned char *)movie_pointer;
-			films.push_back(tmp);
-			films_count--;
-			info_pointer += 4;
-		}
-		return true;
-	}
-	return false;
+	if (offset == start + count) return -1;
+	if (player != ((char*)actorFile) + (*offset)) return -1;
+	return offset - start;
 }
 
-bool imdb::getCast(const film& movie, vector<string>& players) const { 	
+int imdb::findMovie(const filmView& movie) const {
+	if (movieIndex != NULL) {
+		int index = indexLookup(movieIndex, movieKeyHash(movie.title.data(), movie.title.size(), movie.year));
+		if (index == kEmptySlot || !(getMovieView(index) == movie)) return -1;
+		return index;
+	}
 	int count = *(int *) movieFile;
 	int *start = ((int *) movieFile) + 1;
-	int *offset = lower_bound(start, start + count, movie, [this](const int offset, film movie) -> bool {
-									char *targ_pointer = ((char *)movieFile) + offset;
-									string name = targ_pointer;
-									if (movie.title == name) {
-										targ_pointer += name.size() + 1;
-										return 1900 + *(unsigned char *)targ_pointer < movie.year;
-									}
-									return name < movie.title;
+	int *offset = lower_bound(start, start + count, movie, [this](const int offset, const filmView& movie) -> bool {
+									return decodeMovieTitle((char *)movieFile + offset) < movie;
 									});
-	char *info_pointer = ((char*)movieFile) + (*offset);
-	string name = info_pointer;
-	
-	if (name == movie.title) {
-		size_t size = name.size() + 1;
-		info_pointer += size;
-		// int year = 1900 + *(unsigned char *)info_pointer;
-		info_pointer++; size++;
-		if (size & 1) {
-			info_pointer++; size++;
-		}
+	if (offset == start + count) return -1;
+	if (!(getMovieView(offset - start) == movie)) return -1;
+	return offset - start;
+}
 
-		short actors_count = *(short *)info_pointer;
-		info_pointer += 2;
-		if (((size + 2) & 3) > 0) {
-			info_pointer += 2;
-		}
+const char *imdb::getActorName(int actor) const {
+	return (const char *)actorFile + getActorRecordOffset(actor);
+}
 
-		while (actors_count > 0) {
-			int actor_offset = *(int *)info_pointer;
-			char *actor_pointer = (char *)actorFile + actor_offset;
-			players.push_back(actor_pointer);
-			actors_count--;
-			info_pointer += 4;
-		}
-		return true;
-	}
-	return false;
+film imdb::getMovie(int movie) const {
+	return getMovieView(movie).toFilm();
+}
+
+filmView imdb::getMovieView(int movie) const {
+	return decodeMovieTitle((const char *)movieFile + getMovieRecordOffset(movie));
 }
 
-const void *imdb::acquireFileMap(const string& fileName, struct fileInfo& info) {
+int imdb::getActorRecordOffset(int actor) const {
+	return ((const int *) actorFile)[actor + 1];
+}
+
+int imdb::getMovieRecordOffset(int movie) const {
+	return ((const int *) movieFile)[movie + 1];
+}
+
+const int *imdb::getCreditOffsets(int actor, int& count) const {
+	return decodeActorRecord((const char *)actorFile + getActorRecordOffset(actor), count);
+}
+
+const int *imdb::getCastOffsets(int movie, int& count) const {
+	return decodeMovieRecord((const char *)movieFile + getMovieRecordOffset(movie), count);
+}
+
+filmView imdb::decodeMovieTitle(const char *record) {
+	string_view title(record);
+	return filmView(title, 1900 + *(const unsigned char *)(title.data() + title.size() + 1));
+}
+
+/**
+ * An actor record is the name and its '\0' (padded to an even length), a short
+ * holding the number of credits (padded to a multiple of four), then that many
+ * int offsets into the movie file.
+ */
+const int *imdb::decodeActorRecord(const char *record, int& count) {
+	size_t size = strlen(record) + 1;
+	if ((size & 1) == 1) size++;
+	count = *(const short *)(record + size);
+	size += 2;
+	if ((size & 3) > 0) size += 2;
+	return (const int *)(record + size);
+}
+
+/**
+ * A movie record is the title, its '\0' and a year byte (padded to an even length),
+ * a short holding the size of the cast (padded to a multiple of four), then that many
+ * int offsets into the actor file.
+ */
+const int *imdb::decodeMovieRecord(const char *record, int& count) {
+	size_t size = strlen(record) + 2;
+	if ((size & 1) == 1) size++;
+	count = *(const short *)(record + size);
+	size += 2;
+	if ((size & 3) > 0) size += 2;
+	return (const int *)(record + size);
+}
+
+const void *imdb::acquireFileMap(const string& fileName, struct fileInfo& info, unsigned int loadPolicy) {
 	struct stat stats;
-	stat(fileName.c_str(), &stats);
-	info.fileSize = stats.st_size;
+	info.fileSize = 0;
+	info.fileMap = NULL;
 	info.fd = open(fileName.c_str(), O_RDONLY);
-	return info.fileMap = mmap(0, info.fileSize, PROT_READ, MAP_SHARED, info.fd, 0);
+	if (info.fd == -1) return NULL;
+	fstat(info.fd, &stats);
+	info.fileSize = stats.st_size;
+	int flags = MAP_SHARED | ((loadPolicy & kLoadPopulate) ? MAP_POPULATE : 0);
+	void *map = mmap(0, info.fileSize, PROT_READ, flags, info.fd, 0);
+	if (map == MAP_FAILED) {
+		// good() only looks at the descriptors, so an unmapped file mustn't keep one
+		close(info.fd);
+		info.fd = -1;
+		return NULL;
+	}
+
+	// the advice is only a hint, so a kernel that refuses it isn't an error
+	if (loadPolicy & kLoadHugePages) madvise(map, info.fileSize, MADV_HUGEPAGE);
+	if (loadPolicy & kLoadRandom) madvise(map, info.fileSize, MADV_RANDOM);
+	if (loadPolicy & kLoadWillNeed) madvise(map, info.fileSize, MADV_WILLNEED);
+	return info.fileMap = map;
+}
+
+/**
+ * Reads one byte from every page in the specified range, so that any page
+ * faults are taken now rather than by the first queries.
+ */
+void imdb::warmUp(const void *start, size_t length) {
+	static const size_t kPageSize = sysconf(_SC_PAGESIZE);
+	const volatile char *bytes = (const volatile char *) start;
+	char sum = 0;
+	for (size_t offset = 0; offset < length; offset += kPageSize) {
+		sum += bytes[offset];
+	}
+	if (length > 0) sum += bytes[length - 1];
+	(void) sum;
+}
+
+static const struct {
+	const char *name;
+	unsigned int flag;
+} kLoadFlagNames[] = {
+	{"populate", kLoadPopulate},
+	{"willneed", kLoadWillNeed},
+	{"hugepages", kLoadHugePages},
+	{"random", kLoadRandom},
+	{"warmup", kLoadWarmUp},
+};
+
+bool parseLoadPolicy(const string& names, unsigned int& policy) {
+	policy = kLoadLazy;
+	size_t start = 0;
+	while (start <= names.size()) {
+		size_t comma = min(names.find(',', start), names.size());
+		string name = names.substr(start, comma - start);
+		start = comma + 1;
+		if (name == "lazy") continue;
+		bool known = false;
+		for (const auto& entry : kLoadFlagNames) {
+			if (name == entry.name) {
+				policy |= entry.flag;
+				known = true;
+			}
+		}
+		if (!known) return false;
+	}
+	return true;
+}
+
+string loadPolicyName(unsigned int policy) {
+	string names;
+	for (const auto& entry : kLoadFlagNames) {
+		if ((policy & entry.flag) == 0) continue;
+		if (!names.empty()) names += ",";
+		names += entry.name;
+	}
+	return names.empty() ? "lazy" : names;
+}
+
+/**
+ * Maps an index file and makes sure it's one imdb-index-build wrote for the
+ * data file described by dataInfo.  Returns NULL (with the index released)
+ * if it's missing, truncated or stale.
+ */
+const imdbIndexHeader *imdb::acquireIndex(const string& fileName, struct fileInfo& info,
+		const struct fileInfo& dataInfo, unsigned int loadPolicy) {
+	const imdbIndexHeader *header = (const imdbIndexHeader *) acquireFileMap(fileName, info, loadPolicy);
+	if (header != NULL && info.fileSize >= sizeof(imdbIndexHeader) &&
+			header->magic == kIndexMagic && header->dataFileSize == dataInfo.fileSize &&
+			header->bucketCount > 0 && header->slotCount > 0 &&
+			info.fileSize == sizeof(imdbIndexHeader) + header->bucketCount * sizeof(uint32_t) +
+			header->slotCount * sizeof(int32_t)) {
+		return header;
+	}
+	releaseFileMap(info);
+	info.fd = -1;
+	info.fileMap = NULL;
+	return NULL;
 }
 
 void imdb::releaseFileMap(struct fileInfo& info) {
@@ -1,8 +1,121 @@
 #pragma once
 #include "imdb-utils.h"
+#include "imdb-index.h"
 #include <string>
+#include <string_view>
 #include <vector>
 
+/**
+ * Class: creditList
+ * -----------------
+ * A read-only view of an actor/actress's credits, as filled in by the
+ * string_view overload of imdb::getCredits.  Iterating over a creditList
+ * yields filmViews whose titles point straight into the imdb's data file,
+ * so nothing is copied and nothing is allocated.  A creditList is only
+ * valid for as long as the imdb that filled it.
+ */
+
+class creditList {
+ public:
+  class iterator {
+   public:
+    iterator(const char *movieFile, const int *offset) : movieFile(movieFile), offset(offset) {}
+    filmView operator*() const {
+      std::string_view title(movieFile + *offset);
+      return filmView(title, 1900 + *(const unsigned char *)(title.data() + title.size() + 1));
+    }
+    iterator& operator++() { offset++; return *this; }
+    bool operator==(const iterator& rhs) const { return offset == rhs.offset; }
+    bool operator!=(const iterator& rhs) const { return offset != rhs.offset; }
+   private:
+    const char *movieFile;
+    const int *offset;
+  };
+
+  creditList() : movieFile(NULL), offsets(NULL), count(0) {}
+  iterator begin() const { return iterator(movieFile, offsets); }
+  iterator end() const { return iterator(movieFile, offsets + count); }
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+
+ private:
+  friend class imdb;
+  const char *movieFile;
+  const int *offsets;
+  int count;
+};
+
+/**
+ * Constants: kLoadLazy, kLoadPopulate, kLoadWillNeed,
+ *            kLoadHugePages, kLoadRandom, kLoadWarmUp
+ * ----------------------------------------------------
+ * Flags that make up an imdb's loading policy, which controls how its data
+ * and index files are brought into memory.  They're combined with | and
+ * passed to the imdb constructor; kLoadLazy (no flags) is a plain mmap, so
+ * pages are faulted in by whichever queries first touch them.
+ *
+ *     kLoadPopulate   map with MAP_POPULATE, reading every page in before the constructor returns
+ *     kLoadWillNeed   madvise(MADV_WILLNEED), starting readahead of the whole file in the background
+ *     kLoadHugePages  madvise(MADV_HUGEPAGE), asking for huge pages where the kernel supports
+ *                     them for file mappings (it's silently ignored where it doesn't)
+ *     kLoadRandom     madvise(MADV_RANDOM), turning off readahead around page faults
+ *     kLoadWarmUp     touch every page of the two offset tables and of the index files
+ *                     before the constructor returns, since every lookup lands somewhere in them
+ */
+static const unsigned int kLoadLazy = 0;
+static const unsigned int kLoadPopulate = 1 << 0;
+static const unsigned int kLoadWillNeed = 1 << 1;
+static const unsigned int kLoadHugePages = 1 << 2;
+static const unsigned int kLoadRandom = 1 << 3;
+static const unsigned int kLoadWarmUp = 1 << 4;
+
+/**
+ * Functions: parseLoadPolicy
+ *            loadPolicyName
+ * ---------------------------
+ * Convert between a loading policy and its comma-separated list of flag names
+ * ("lazy", "populate", "willneed", "hugepages", "random", "warmup"), so that
+ * the policy can be picked on the command line.  parseLoadPolicy returns
+ * false if any of the names isn't recognized.
+ */
+bool parseLoadPolicy(const std::string& names, unsigned int& policy);
+std::string loadPolicyName(unsigned int policy);
+
+/**
+ * Class: castList
+ * ---------------
+ * The getCast counterpart of creditList: iterating over a castList yields
+ * the name of each member of the cast as a std::string_view into the imdb's
+ * data file.
+ */
+
+class castList {
+ public:
+  class iterator {
+   public:
+    iterator(const char *actorFile, const int *offset) : actorFile(actorFile), offset(offset) {}
+    std::string_view operator*() const { return std::string_view(actorFile + *offset); }
+    iterator& operator++() { offset++; return *this; }
+    bool operator==(const iterator& rhs) const { return offset == rhs.offset; }
+    bool operator!=(const iterator& rhs) const { return offset != rhs.offset; }
+   private:
+    const char *actorFile;
+    const int *offset;
+  };
+
+  castList() : actorFile(NULL), offsets(NULL), count(0) {}
+  iterator begin() const { return iterator(actorFile, offsets); }
+  iterator end() const { return iterator(actorFile, offsets + count); }
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+
+ private:
+  friend class imdb;
+  const char *actorFile;
+  const int *offsets;
+  int count;
+};
+
 class imdb {
  public:
   
@@ -15,10 +128,16 @@ class imdb {
  * all of the information about the movies and actors relevant to an IMDB
  * application (like six-degrees).
  *
+ * If the directory also contains up-to-date actorindex and movieindex files
+ * (see imdb-index-build), they're mapped as well, and name lookups go
+ * through them in constant time instead of binary searching.
+ *
  * @param directory the name of the directory housing the formatted information backing the imdb.
+ * @param useIndex false to ignore any index files and always binary search.
+ * @param loadPolicy the kLoad flags saying how the files should be brought into memory.
  */
 
-  imdb(const std::string& directory);
+  imdb(const std::string& directory, bool useIndex = true, unsigned int loadPolicy = kLoadLazy);
 
 /**
  * Predicate Method: good
@@ -69,6 +188,89 @@ class imdb {
 
   bool getCast(const film& movie, std::vector<std::string>& players) const;
 
+/**
+ * Methods: getCredits
+ *          getCast
+ * -------------------
+ * Zero-copy versions of the two methods above.  Rather than copying every
+ * title or name into a vector, they point the supplied creditList or castList
+ * at the list already sitting in the data file.  If the actor/actress or movie
+ * isn't in the database, the list is left empty and false is returned.
+ *
+ * @param player the name of the actor or actresses being queried.
+ * @param credits the creditList to be pointed at the specified actor/actress's credits.
+ * @param movie the film (title and year) being queried.
+ * @param cast the castList to be pointed at the specified movie's cast.
+ * @return true if and only if the specified actor/actress or movie appeared in the database.
+ */
+
+  bool getCredits(std::string_view player, creditList& credits) const;
+  bool getCast(const filmView& movie, castList& cast) const;
+
+/**
+ * Methods: getActorCount
+ *          getMovieCount
+ * -----------------------
+ * Returns the number of actors/actresses (or movies) in the database.  Actors
+ * and movies are also identified by their index into the sorted record tables,
+ * which is a number in the range [0, getActorCount()) (or [0, getMovieCount())).
+ * The methods below that take an actor or movie index all expect one in range.
+ */
+
+  int getActorCount() const;
+  int getMovieCount() const;
+
+/**
+ * Methods: findActor
+ *          findMovie
+ * -------------------
+ * Looks up the specified actor/actress (or movie) in the index, or binary
+ * searches the sorted record table if there is no index, and returns its
+ * record index, or -1 if it isn't in the database.
+ */
+
+  int findActor(std::string_view player) const;
+  int findMovie(const filmView& movie) const;
+
+/**
+ * Methods: getActorName
+ *          getMovie
+ *          getMovieView
+ * ----------------------
+ * Returns the name of the actor/actress (or the title and year of the movie)
+ * at the specified index.  getActorName and getMovieView point straight into
+ * the read-only data file, so they remain valid for as long as the imdb does.
+ */
+
+  const char *getActorName(int actor) const;
+  film getMovie(int movie) const;
+  filmView getMovieView(int movie) const;
+
+/**
+ * Methods: getActorRecordOffset
+ *          getMovieRecordOffset
+ * ------------------------------
+ * Returns the byte offset of the actor (or movie) record at the specified index.
+ * These are the values that appear in the lists returned by getCreditOffsets
+ * and getCastOffsets, so they're what's needed to map those lists back to indices.
+ */
+
+  int getActorRecordOffset(int actor) const;
+  int getMovieRecordOffset(int movie) const;
+
+/**
+ * Methods: getCreditOffsets
+ *          getCastOffsets
+ * ------------------------
+ * Returns the address of the array of movie record offsets making up the
+ * specified actor's credits (or the actor record offsets making up the specified
+ * movie's cast), and sets count to the length of that array.  The array lives
+ * in the read-only data file, so nothing is copied or allocated.
+ */
+
+  const int *getCreditOffsets(int actor, int& count) const;
+  const int *getCastOffsets(int movie, int& count) const;
+
 /**
  * Destructor: ~imdb
  * -----------------
@@ -82,6 +284,8 @@ class imdb {
   static const char *const kMovieFileName;
   const void *actorFile;
   const void *movieFile;
+  const imdbIndexHeader *actorIndex; // NULL when there's no usable index
+  const imdbIndexHeader *movieIndex;
   
   // everything below here is complicated and needn't be touched.
   // you're free to investigate, but you're on your own.
@@ -89,10 +293,16 @@ class imdb {
     int fd;
     size_t fileSize;
     const void *fileMap;
-  } actorInfo, movieInfo;
+  } actorInfo, movieInfo, actorIndexInfo, movieIndexInfo;
   
-  static const void *acquireFileMap(const std::string& fileName, struct fileInfo& info);
+  static const void *acquireFileMap(const std::string& fileName, struct fileInfo& info, unsigned int loadPolicy);
   static void releaseFileMap(struct fileInfo& info);
+  static const imdbIndexHeader *acquireIndex(const std::string& fileName, struct fileInfo& info,
+                                             const struct fileInfo& dataInfo, unsigned int loadPolicy);
+  static void warmUp(const void *start, size_t length);
+  static const int *decodeActorRecord(const char *record, int& count);
+  static const int *decodeMovieRecord(const char *record, int& count);
+  static filmView decodeMovieTitle(const char *record);
 
   imdb(const imdb& original) = delete;
   imdb& operator=(const imdb& rhs) = delete;
@@ -3,6 +3,7 @@
 #include <map>
 #include <set>
 #include <string>
+#include <string_view>
 #include "imdb.h"
 using namespace std;
 
@@ -33,22 +34,22 @@ static void printFill(const string& noun) {
  * @param credits the specified actor's/actress's list of movie
  *                credits.
  */
-static void listMovies(const string& player, const vector<film>& credits) {
+static void listMovies(const string& player, const creditList& credits) {
 	const unsigned int kNumFilmsToPrint = 10;
 	cout << endl;
 	cout << "  " << player << " has starred in " << (int) (credits.size()) << " films, "
 		<< "and those films are:" << endl << endl;
 	unsigned int numMovies = 0;
-	vector<film>::const_iterator curr;
-	for (curr = credits.begin(); curr != credits.end() && numMovies < kNumFilmsToPrint; ++curr) {
-		const film& movie = *curr;
+	creditList::iterator curr = credits.begin();
+	for (; curr != credits.end() && numMovies < kNumFilmsToPrint; ++curr) {
+		filmView movie = *curr;
 		cout << setw(5) << ++numMovies << ".) " << movie.title << " (" << movie.year << ")" << endl;
 	}
 	if (curr != credits.end()) {
 		if (credits.size() > 2 * kNumFilmsToPrint) printFill("films");
 		while (numMovies < (credits.size() - kNumFilmsToPrint)) { numMovies++; ++curr; }
 		for (;curr != credits.end(); ++curr) {
-			const film& movie = *curr;
+			filmView movie = *curr;
 			cout << setw(5) << ++numMovies << ".) " << movie.title << " (" << movie.year << ")" << endl;      
 		}
 	}
@@ -60,7 +61,8 @@ static void listMovies(const string& player, const vector<film>& credits) {
  * Builds up the list of costars and then prints all these
  * costars in a format similar to that used by listMovies.
  * The STL set is used to collect actor/actress names without
- * storing duplicates.
+ * storing duplicates.  Names and titles are string_views into the
+ * imdb's data files, so nothing is copied along the way.
  *
  * @param player the actor/actress of interest.
  * @param credits the list of movies that the specified actor/actress has appeared in.
@@ -70,15 +72,13 @@ static void listMovies(const string& player, const vector<film>& credits) {
  *           so that each member of each cast of each movie can be added to the specified player's
  *           set of costars.
  */
-static void listCostars(const string &player, const vector<film>& credits, const imdb& db) {
+static void listCostars(const string &player, const creditList& credits, const imdb& db) {
 	const unsigned int kNumCostarsToPrint = 10;
-	map<string, set<film>> costars;
-	for (int i = 0; i < (int) credits.size(); i++) {
-		const film& movie = credits[i];
-		vector<string> cast;
+	map<string_view, set<filmView>> costars;
+	for (filmView movie : credits) {
+		castList cast;
 		db.getCast(movie, cast);
-		for (int j = 0; j < (int) cast.size(); j++) {
-			const string& costar = cast[j];
+		for (string_view costar : cast) {
 			if (costar != player) {
 				costars[costar].insert(movie);
 			}
@@ -90,9 +90,9 @@ static void listCostars(const string &player, const vector<film>& credits, const
 		<< "and those other people are:" << endl << endl;
 
 	unsigned int numCostars = 0;
-	map<string, set<film>>::const_iterator curr;
+	map<string_view, set<filmView>>::const_iterator curr;
 	for (curr = costars.begin(); curr != costars.end() && numCostars < kNumCostarsToPrint; ++curr) {
-		const string& costar = curr->first;
+		string_view costar = curr->first;
 		cout << setw(5) << ++numCostars << ".) " << costar;
 		if (curr->second.size() > 1) cout << " (in " << (int) curr->second.size() << " different films)";
 		cout << endl;
@@ -102,7 +102,7 @@ static void listCostars(const string &player, const vector<film>& credits, const
 		if (costars.size() > 2 * kNumCostarsToPrint) printFill("people");
 		while (numCostars < costars.size() - kNumCostarsToPrint) { numCostars++; ++curr; }
 		for (; curr != costars.end(); ++curr) {
-			const string& costar = curr->first;
+			string_view costar = curr->first;
 			cout << setw(5) << ++numCostars << ".) " << costar;
 			if (curr->second.size() > 1) cout << " (in " << (int) curr->second.size() << " different films)";
 			cout << endl;
@@ -120,7 +120,7 @@ static void listCostars(const string &player, const vector<film>& credits, const
  * appeared in a non-zero number of films.)  If the specified
  * actor/actress is missing (or if there are no films to speak
  * of), then a polite message is printed and we return immediately.
- * Otherwise, we assume that the local vector<film> has been populated
+ * Otherwise, we assume that the local creditList has been populated
  * with real data, and we pass the buck onto the listMovies and the
  * listCostars routines.  See the documentation for each of those functions
  * on what they do and how they work.
@@ -132,7 +132,7 @@ static void listCostars(const string &player, const vector<film>& credits, const
  *           good test.
  */
 static void listAllMoviesAndCostars(const imdb& db, const string& player) {
-	vector<film> credits;
+	creditList credits;
 	if (!db.getCredits(player, credits) || credits.size() == 0) {
 		cout << "We're sorry, but " << player 
 			<< " doesn't appear to be in our database." << endl;
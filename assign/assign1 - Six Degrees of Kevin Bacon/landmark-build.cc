@@ -0,0 +1,76 @@
+/**
+ * File: landmark-build.cc
+ * -----------------------
+ * Builds the landmarks file that lets search bound the distance between two
+ * actors without searching.  The landmarks are chosen farthest first, and the
+ * breadth-first distance from each of them to every actor is written into the
+ * same directory as the actordata file it was computed from.  Like the name
+ * indices, it needs to be rebuilt whenever actordata changes.
+ */
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include "imdb.h"
+#include "imdb-graph.h"
+#include "landmark-oracle.h"
+using namespace std;
+
+static const int kWrongArgumentCount = 1;
+static const int kDatabaseNotFound = 2;
+static const int kLandmarksNotWritten = 3;
+static const int kDefaultLandmarkCount = 16;
+
+static uint64_t fileSize(const string& fileName) {
+	struct stat stats;
+	if (stat(fileName.c_str(), &stats) == -1) return 0;
+	return stats.st_size;
+}
+
+static void printUsage(const char *progname) {
+	cerr << "Usage: " << progname << " [-k <landmarks>] [<data-directory>]" << endl;
+}
+
+int main(int argc, char *argv[]) {
+	int count = kDefaultLandmarkCount;
+	int opt;
+	while ((opt = getopt(argc, argv, "k:")) != -1) {
+		if (opt != 'k' || (count = atoi(optarg)) < 1) {
+			printUsage(argv[0]);
+			return kWrongArgumentCount;
+		}
+	}
+	if (argc - optind > 1) {
+		printUsage(argv[0]);
+		return kWrongArgumentCount;
+	}
+	string directory = optind < argc ? argv[optind] : kIMDBDataDirectory;
+	imdb db(directory);
+	if (!db.good()) {
+		cerr << "Data directory not found!  Aborting..." << endl;
+		return kDatabaseNotFound;
+	}
+
+	auto start = chrono::steady_clock::now();
+	imdbGraph graph(db);
+	vector<vector<uint8_t>> distances;
+	vector<int> landmarks = chooseLandmarks(graph, count, distances);
+	string fileName = directory + "/" + kLandmarkFileName;
+	if (!writeLandmarks(fileName, landmarks, distances, fileSize(directory + "/actordata"))) {
+		cerr << "Couldn't write " << fileName << "." << endl;
+		return kLandmarksNotWritten;
+	}
+	auto stop = chrono::steady_clock::now();
+
+	for (int landmark : landmarks) {
+		cout << "  " << graph.getActorName(landmark) << endl;
+	}
+	cout << "Wrote " << fileName << " (" << landmarks.size() << " landmarks, " << fileSize(fileName)
+	     << " bytes) in " << fixed << setprecision(1) << chrono::duration<double, milli>(stop - start).count()
+	     << " ms." << endl;
+	return 0;
+}
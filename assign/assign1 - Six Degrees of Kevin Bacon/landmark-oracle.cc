@@ -0,0 +1,141 @@
+#include "landmark-oracle.h"
+#include <algorithm>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+using namespace std;
+
+void actorDistances(const imdbGraph& graph, int root, vector<uint8_t>& distances) {
+	distances.assign(graph.getActorCount(), kUnreachable);
+	vector<bool> movieSeen(graph.getMovieCount(), false);
+	vector<int> frontier(1, root), next;
+	distances[root] = 0;
+	for (int level = 1; !frontier.empty() && level < kUnreachable; level++) {
+		next.clear();
+		for (int actor : frontier) {
+			for (const int *movie = graph.creditsBegin(actor); movie != graph.creditsEnd(actor); movie++) {
+				if (movieSeen[*movie]) continue;
+				movieSeen[*movie] = true;
+				for (const int *costar = graph.castBegin(*movie); costar != graph.castEnd(*movie); costar++) {
+					if (distances[*costar] != kUnreachable) continue;
+					distances[*costar] = level;
+					next.push_back(*costar);
+				}
+			}
+		}
+		frontier.swap(next);
+	}
+}
+
+vector<int> chooseLandmarks(const imdbGraph& graph, int count, vector<vector<uint8_t>>& distances) {
+	vector<int> landmarks;
+	distances.clear();
+	int actorCount = graph.getActorCount();
+	if (actorCount == 0) return landmarks;
+
+	int landmark = 0;
+	for (int actor = 1; actor < actorCount; actor++) {
+		if (graph.creditsEnd(actor) - graph.creditsBegin(actor) >
+				graph.creditsEnd(landmark) - graph.creditsBegin(landmark)) {
+			landmark = actor;
+		}
+	}
+
+	// closest[a] is the distance from a to the nearest landmark chosen so far
+	vector<uint8_t> closest(actorCount, kUnreachable);
+	while ((int) landmarks.size() < min(count, actorCount)) {
+		landmarks.push_back(landmark);
+		distances.push_back(vector<uint8_t>());
+		actorDistances(graph, landmark, distances.back());
+		const vector<uint8_t>& latest = distances.back();
+		for (int actor = 0; actor < actorCount; actor++) {
+			closest[actor] = min(closest[actor], latest[actor]);
+		}
+		landmark = max_element(closest.begin(), closest.end()) - closest.begin();
+		if (closest[landmark] == 0) break; // every actor is already a landmark
+	}
+	return landmarks;
+}
+
+bool writeLandmarks(const string& fileName, const vector<int>& landmarks,
+		const vector<vector<uint8_t>>& distances, uint64_t dataFileSize) {
+	landmarkHeader header;
+	header.magic = kLandmarkMagic;
+	header.landmarkCount = landmarks.size();
+	header.actorCount = landmarks.empty() ? 0 : distances[0].size();
+	header.reserved = 0;
+	header.dataFileSize = dataFileSize;
+
+	vector<int32_t> ids(landmarks.begin(), landmarks.end());
+	vector<uint8_t> rows((size_t) header.actorCount * header.landmarkCount);
+	for (size_t actor = 0; actor < header.actorCount; actor++) {
+		for (size_t i = 0; i < header.landmarkCount; i++) {
+			rows[actor * header.landmarkCount + i] = distances[i][actor];
+		}
+	}
+
+	FILE *outfile = fopen(fileName.c_str(), "wb");
+	if (outfile == NULL) return false;
+	bool written = fwrite(&header, sizeof(header), 1, outfile) == 1 &&
+		fwrite(ids.data(), sizeof(int32_t), ids.size(), outfile) == ids.size() &&
+		fwrite(rows.data(), sizeof(uint8_t), rows.size(), outfile) == rows.size();
+	return fclose(outfile) == 0 && written;
+}
+
+landmarkOracle::landmarkOracle(const string& directory) : fd(-1), fileSize(0), header(NULL),
+		landmarks(NULL), distances(NULL) {
+	struct stat stats;
+	if (stat((directory + "/actordata").c_str(), &stats) == -1) return;
+	uint64_t dataFileSize = stats.st_size;
+
+	fd = open((directory + "/" + kLandmarkFileName).c_str(), O_RDONLY);
+	if (fd == -1) return;
+	fstat(fd, &stats);
+	fileSize = stats.st_size;
+	if (fileSize < sizeof(landmarkHeader)) return;
+	void *map = mmap(0, fileSize, PROT_READ, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) return;
+
+	const landmarkHeader *candidate = (const landmarkHeader *) map;
+	if (candidate->magic != kLandmarkMagic || candidate->dataFileSize != dataFileSize ||
+			candidate->landmarkCount == 0 ||
+			fileSize != sizeof(landmarkHeader) + candidate->landmarkCount * sizeof(int32_t) +
+			(size_t) candidate->actorCount * candidate->landmarkCount) {
+		munmap(map, fileSize);
+		return;
+	}
+	header = candidate;
+	landmarks = (const int32_t *) (header + 1);
+	distances = (const uint8_t *) (landmarks + header->landmarkCount);
+}
+
+int landmarkOracle::lowerBound(int a, int b) const {
+	const uint8_t *da = distances + (size_t) a * header->landmarkCount;
+	const uint8_t *db = distances + (size_t) b * header->landmarkCount;
+	int bound = 0;
+	for (uint32_t i = 0; i < header->landmarkCount; i++) {
+		if (da[i] == db[i]) continue;
+		if (da[i] == kUnreachable || db[i] == kUnreachable) return kUnreachable;
+		bound = max(bound, abs(da[i] - db[i]));
+	}
+	return bound;
+}
+
+int landmarkOracle::upperBound(int a, int b) const {
+	const uint8_t *da = distances + (size_t) a * header->landmarkCount;
+	const uint8_t *db = distances + (size_t) b * header->landmarkCount;
+	int bound = kUnreachable;
+	for (uint32_t i = 0; i < header->landmarkCount; i++) {
+		if (da[i] == kUnreachable || db[i] == kUnreachable) continue;
+		bound = min(bound, da[i] + db[i]);
+	}
+	return bound;
+}
+
+landmarkOracle::~landmarkOracle() {
+	if (header != NULL) munmap((void *) header, fileSize);
+	if (fd != -1) close(fd);
+}
@@ -0,0 +1,129 @@
+#pragma once
+#include "imdb-graph.h"
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * File: landmark-oracle.h
+ * -----------------------
+ * Defines the on-disk landmarks file that lives next to actordata, and the
+ * landmarkOracle that maps it.  The file records, for a handful of landmark
+ * actors, the breadth-first distance (in films) from each landmark to every
+ * actor in the graph.  By the triangle inequality, any two actors a and b
+ * then satisfy
+ *
+ *     |d(L, a) - d(L, b)| <= d(a, b) <= d(L, a) + d(L, b)
+ *
+ * for every landmark L, which gives cheap lower and upper bounds on the
+ * distance between any two actors without searching.
+ *
+ * Layout: a landmarkHeader, then landmarkCount int32_t actor ids, then
+ * actorCount rows of landmarkCount uint8_t distances (all of one actor's
+ * distances are adjacent, so a bound costs one cache line per actor).
+ */
+
+static const char *const kLandmarkFileName = "landmarks";
+static const uint32_t kLandmarkMagic = 0x314b4d4c; // "LMK1"
+static const uint8_t kUnreachable = 255;
+
+struct landmarkHeader {
+  uint32_t magic;
+  uint32_t landmarkCount;
+  uint32_t actorCount;
+  uint32_t reserved;
+  uint64_t dataFileSize; // size of the actordata file the distances were computed from
+};
+
+/**
+ * Function: actorDistances
+ * ------------------------
+ * Runs a breadth-first search over the whole graph from the specified actor,
+ * overwriting distances with the number of films separating every actor from
+ * it (kUnreachable for anyone in a different component, or further away than
+ * kUnreachable - 1 films).
+ */
+void actorDistances(const imdbGraph& graph, int root, std::vector<uint8_t>& distances);
+
+/**
+ * Function: chooseLandmarks
+ * -------------------------
+ * Picks the specified number of landmark actors, farthest first: the first is
+ * the actor with the most credits, and each one after that is the actor
+ * furthest from all of the landmarks chosen so far (preferring actors in
+ * components no landmark reaches yet).  Spreading landmarks out this way makes
+ * the lower bounds much tighter than picking hubs alone.  The distances from
+ * each landmark are computed along the way and returned through distances.
+ */
+std::vector<int> chooseLandmarks(const imdbGraph& graph, int count,
+                                 std::vector<std::vector<uint8_t>>& distances);
+
+/**
+ * Function: writeLandmarks
+ * ------------------------
+ * Writes a landmarks file holding the specified landmarks and their distances,
+ * as returned by chooseLandmarks.
+ *
+ * @return true if and only if the file was written successfully.
+ */
+bool writeLandmarks(const std::string& fileName, const std::vector<int>& landmarks,
+                    const std::vector<std::vector<uint8_t>>& distances, uint64_t dataFileSize);
+
+/**
+ * Class: landmarkOracle
+ * ---------------------
+ * Maps a landmarks file and answers distance-bound questions about pairs
+ * of actor ids.  Bounds are in films, exactly like path lengths.
+ */
+
+class landmarkOracle {
+ public:
+
+/**
+ * Constructor: landmarkOracle
+ * ---------------------------
+ * Maps the landmarks file in the specified data directory.  The file is
+ * ignored (and good returns false) if it's missing, malformed, or was built
+ * from an actordata file of a different size.
+ */
+
+  landmarkOracle(const std::string& directory);
+
+/**
+ * Predicate Method: good
+ * ----------------------
+ * Returns true if and only if a usable landmarks file was mapped.
+ */
+
+  bool good() const { return header != NULL; }
+
+  int getLandmarkCount() const { return header->landmarkCount; }
+  int getLandmark(int i) const { return landmarks[i]; }
+  uint8_t getDistance(int landmark, int actor) const { return distances[(size_t) actor * header->landmarkCount + landmark]; }
+
+/**
+ * Methods: lowerBound
+ *          upperBound
+ * -------------------
+ * Returns a lower (or upper) bound on the number of films separating two
+ * actors.  lowerBound returns kUnreachable when some landmark reaches one of
+ * the actors but not the other, since they're then in different components.
+ * upperBound returns kUnreachable when no landmark reaches both.
+ */
+
+  int lowerBound(int a, int b) const;
+  int upperBound(int a, int b) const;
+
+  ~landmarkOracle();
+
+ private:
+  int fd;
+  size_t fileSize;
+  const landmarkHeader *header;
+  const int32_t *landmarks;
+  const uint8_t *distances;
+
+  landmarkOracle(const landmarkOracle& original) = delete;
+  landmarkOracle& operator=(const landmarkOracle& rhs) = delete;
+};
@@ -0,0 +1,124 @@
+/**
+ * File: parallel-bench.cc
+ * -----------------------
+ * Reports how the parallel graph search scales with the number of threads.
+ * Every pair is searched with 1, 2, 4, ... threads (up to the number of cores,
+ * or the -t limit), and the total time for each thread count is printed along
+ * with its speedup over a single thread.
+ *
+ * Pairs are read from the file named on the command line (tab-separated, one
+ * pair per line).  Without a file, the benchmark makes its own hard pairs: each
+ * of the kNumHubs actors with the most credits is paired with an obscure actor
+ * (one credit), so every search has to push through enormous frontiers.
+ */
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <thread>
+#include <unistd.h>
+#include <stdlib.h>
+#include "imdb.h"
+#include "imdb-graph.h"
+#include "parallel-search.h"
+using namespace std;
+
+static const int kWrongArgumentCount = 1;
+static const int kDatabaseNotFound = 2;
+static const int kPairsFileNotFound = 3;
+static const int kNumHubs = 8;
+static const int kRounds = 3;
+
+static bool readPairs(const char *filename, vector<pair<string, string>>& pairs) {
+	ifstream infile(filename);
+	if (!infile) return false;
+	string line;
+	while (getline(infile, line)) {
+		size_t tab = line.find('\t');
+		if (tab == string::npos) continue;
+		pairs.push_back(make_pair(line.substr(0, tab), line.substr(tab + 1)));
+	}
+	return true;
+}
+
+static void makeHardPairs(const imdbGraph& graph, vector<pair<string, string>>& pairs) {
+	vector<pair<int, int>> degrees; // (credits, actor)
+	vector<int> obscure;
+	for (int actor = 0; actor < graph.getActorCount(); actor++) {
+		int credits = graph.creditsEnd(actor) - graph.creditsBegin(actor);
+		degrees.push_back(make_pair(credits, actor));
+		if (credits == 1) obscure.push_back(actor);
+	}
+	int numHubs = min<int>(kNumHubs, degrees.size());
+	partial_sort(degrees.begin(), degrees.begin() + numHubs, degrees.end(), greater<pair<int, int>>());
+	for (int i = 0; i < numHubs && !obscure.empty(); i++) {
+		int target = obscure[(i * obscure.size()) / numHubs];
+		pairs.push_back(make_pair(graph.getActorName(degrees[i].second), graph.getActorName(target)));
+	}
+}
+
+int main(int argc, char *argv[]) {
+	int maxThreads = max(1u, thread::hardware_concurrency());
+	int opt;
+	while ((opt = getopt(argc, argv, "t:")) != -1) {
+		if (opt != 't' || atoi(optarg) < 1) {
+			cerr << "Usage: " << argv[0] << " [-t <max-threads>] [<pairs-file>]" << endl;
+			return kWrongArgumentCount;
+		}
+		maxThreads = atoi(optarg);
+	}
+	if (argc - optind > 1) {
+		cerr << "Usage: " << argv[0] << " [-t <max-threads>] [<pairs-file>]" << endl;
+		return kWrongArgumentCount;
+	}
+
+	imdb db(kIMDBDataDirectory);
+	if (!db.good()) {
+		cerr << "Data directory not found!  Aborting..." << endl;
+		return kDatabaseNotFound;
+	}
+	imdbGraph graph(db);
+
+	vector<pair<string, string>> pairs;
+	if (optind < argc) {
+		if (!readPairs(argv[optind], pairs)) {
+			cerr << "Can't read pairs from " << argv[optind] << endl;
+			return kPairsFileNotFound;
+		}
+	} else {
+		makeHardPairs(graph, pairs);
+	}
+	for (const pair<string, string>& actors : pairs) {
+		cout << "  " << actors.first << " -> " << actors.second << endl;
+	}
+	cout << endl;
+
+	vector<int> threadCounts;
+	for (int numThreads = 1; numThreads < maxThreads; numThreads *= 2) threadCounts.push_back(numThreads);
+	threadCounts.push_back(maxThreads);
+
+	cout << setw(8) << "threads" << setw(12) << "actors" << setw(12) << "films"
+	     << setw(12) << "ms" << setw(10) << "speedup" << endl;
+	double baseline = 0;
+	for (int numThreads : threadCounts) {
+		parallelSearcher searcher(graph, numThreads);
+		searchStats stats;
+		auto start = chrono::steady_clock::now();
+		for (int round = 0; round < kRounds; round++) {
+			for (const pair<string, string>& actors : pairs) {
+				path p(actors.first);
+				searcher.search(actors.first, actors.second, p, stats);
+			}
+		}
+		auto stop = chrono::steady_clock::now();
+		double ms = chrono::duration<double, milli>(stop - start).count();
+		if (baseline == 0) baseline = ms;
+		cout << setw(8) << numThreads << setw(12) << stats.actorsExpanded << setw(12) << stats.filmsExpanded
+		     << setw(12) << fixed << setprecision(1) << ms << setw(9) << setprecision(2) << baseline / ms << "x" << endl;
+	}
+	return 0;
+}
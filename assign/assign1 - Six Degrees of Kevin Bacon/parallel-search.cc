@@ -0,0 +1,141 @@
+#include "parallel-search.h"
+#include <algorithm>
+using namespace std;
+
+static const size_t kChunkSize = 64;
+
+/**
+ * Claims bit i in bits for the calling thread.  Returns true if and only if
+ * the bit was clear beforehand, i.e. if this thread is the one that claimed it.
+ */
+static inline bool claim(vector<atomic<uint64_t>>& bits, int i) {
+	uint64_t mask = uint64_t(1) << (i & 63);
+	if (bits[i >> 6].load(memory_order_relaxed) & mask) return false;
+	return (bits[i >> 6].fetch_or(mask, memory_order_relaxed) & mask) == 0;
+}
+
+parallelSearcher::parallelSearcher(const imdbGraph& graph, int numThreads) :
+	graph(graph), numThreads(max(1, numThreads)),
+	actorSeen((graph.getActorCount() + 63) / 64), movieSeen((graph.getMovieCount() + 63) / 64),
+	beforeActor(graph.getActorCount()), beforeMovie(graph.getMovieCount()),
+	next(this->numThreads), threadStats(this->numThreads),
+	target(-1), nextChunk(0), found(false), generation(0), running(0), stopping(false) {
+	for (int id = 0; id < this->numThreads - 1; id++) {
+		workers.push_back(thread([this, id] { worker(id); }));
+	}
+}
+
+parallelSearcher::~parallelSearcher() {
+	{
+		lock_guard<mutex> lg(m);
+		stopping = true;
+	}
+	levelReady.notify_all();
+	for (thread& t : workers) t.join();
+}
+
+void parallelSearcher::worker(int id) {
+	unsigned int seen = 0;
+	while (true) {
+		unique_lock<mutex> ul(m);
+		levelReady.wait(ul, [this, seen] { return stopping || generation != seen; });
+		if (stopping) return;
+		seen = generation;
+		ul.unlock();
+		expandLevel(id);
+		ul.lock();
+		if (--running == 0) levelDone.notify_one();
+	}
+}
+
+/**
+ * Repeatedly claims the next kChunkSize actors of the frontier and expands
+ * them, until the frontier is used up or some thread has found the target.
+ */
+void parallelSearcher::expandLevel(int id) {
+	vector<int>& discovered = next[id];
+	searchStats& stats = threadStats[id];
+	while (!found.load(memory_order_relaxed)) {
+		size_t first = nextChunk.fetch_add(kChunkSize, memory_order_relaxed);
+		if (first >= frontier.size()) break;
+		size_t last = min(first + kChunkSize, frontier.size());
+		for (size_t i = first; i < last; i++) {
+			int actor = frontier[i];
+			stats.actorsExpanded++;
+			for (const int *movie = graph.creditsBegin(actor); movie != graph.creditsEnd(actor); movie++) {
+				if (!claim(movieSeen, *movie)) continue;
+				beforeMovie[*movie] = actor;
+				stats.filmsExpanded++;
+				for (const int *costar = graph.castBegin(*movie); costar != graph.castEnd(*movie); costar++) {
+					if (!claim(actorSeen, *costar)) continue;
+					beforeActor[*costar] = *movie;
+					discovered.push_back(*costar);
+					if (*costar == target) found = true;
+				}
+			}
+		}
+	}
+}
+
+/**
+ * Hands the current frontier to every worker, expands it alongside them,
+ * waits for all of them to finish, then merges their discoveries into
+ * the next frontier.
+ */
+void parallelSearcher::runLevel() {
+	nextChunk = 0;
+	for (vector<int>& discovered : next) discovered.clear();
+	{
+		lock_guard<mutex> lg(m);
+		running = numThreads - 1;
+		generation++;
+	}
+	levelReady.notify_all();
+	expandLevel(numThreads - 1);
+	{
+		unique_lock<mutex> ul(m);
+		levelDone.wait(ul, [this] { return running == 0; });
+	}
+	frontier.clear();
+	for (const vector<int>& discovered : next) {
+		frontier.insert(frontier.end(), discovered.begin(), discovered.end());
+	}
+}
+
+bool parallelSearcher::search(const string& source, const string& target, path& p, searchStats& stats) {
+	int from = graph.findActor(source);
+	int to = graph.findActor(target);
+	if (from == -1 || to == -1) return false;
+	if (from == to) {
+		p = path(source);
+		return true;
+	}
+
+	for (atomic<uint64_t>& word : actorSeen) word.store(0, memory_order_relaxed);
+	for (atomic<uint64_t>& word : movieSeen) word.store(0, memory_order_relaxed);
+	for (searchStats& counters : threadStats) counters = searchStats();
+	claim(actorSeen, from);
+	frontier.assign(1, from);
+	this->target = to;
+	found = false;
+	for (int level = 0; level < kMaxPathLength && !found && !frontier.empty(); level++) {
+		runLevel();
+	}
+	for (const searchStats& counters : threadStats) {
+		stats.actorsExpanded += counters.actorsExpanded;
+		stats.filmsExpanded += counters.filmsExpanded;
+	}
+	if (!found) return false;
+
+	vector<int> legs; // movies from the target back to the source
+	for (int actor = to; actor != from; actor = beforeMovie[legs.back()]) {
+		legs.push_back(beforeActor[actor]);
+	}
+	p = path(source);
+	for (size_t i = legs.size(); i > 0; i--) {
+		int movie = legs[i - 1];
+		int actor = (i == 1) ? to : beforeMovie[legs[i - 2]];
+		p.addConnection(graph.getMovie(movie), graph.getActorName(actor));
+	}
+	return true;
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include "imdb-graph.h"
+#include "path.h"
+#include "search-engine.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+/**
+ * Class: parallelSearcher
+ * -----------------------
+ * Level-synchronous breadth-first search over an imdbGraph, with each level's
+ * frontier split across a fixed pool of worker threads.  Workers claim chunks
+ * of the frontier from a shared counter, mark actors and movies visited with
+ * atomic fetch_or on shared bitsets (so every vertex is claimed by exactly one
+ * worker, which alone records its predecessor), and collect what they discover
+ * into private next-frontier vectors that are concatenated between levels.
+ *
+ * The pool and all of the scratch space are created once, so a single
+ * parallelSearcher can serve any number of searches, one at a time.
+ */
+
+class parallelSearcher {
+ public:
+
+/**
+ * Constructor: parallelSearcher
+ * -----------------------------
+ * Sizes the scratch space for the specified graph and starts numThreads - 1
+ * worker threads (the thread calling search is always the last worker).
+ *
+ * @param graph the compact graph to be searched.  It must outlive the searcher.
+ * @param numThreads the number of threads that should share each level, at least 1.
+ */
+
+  parallelSearcher(const imdbGraph& graph, int numThreads);
+
+/**
+ * Method: search
+ * --------------
+ * Same contract as graphSearch with bidirectional set to false.
+ *
+ * @param source the actor/actress the path should start with.
+ * @param target the actor/actress the path should end with.
+ * @param p the path to be overwritten when a connection is found.
+ * @param stats the counters to be incremented as actors and films are expanded.
+ * @return true if and only if a path of length kMaxPathLength or less was found.
+ */
+
+  bool search(const std::string& source, const std::string& target, path& p, searchStats& stats);
+
+  int getNumThreads() const { return numThreads; }
+
+/**
+ * Destructor: ~parallelSearcher
+ * -----------------------------
+ * Stops and joins the worker threads.
+ */
+
+  ~parallelSearcher();
+
+ private:
+  const imdbGraph& graph;
+  int numThreads;
+
+  std::vector<std::atomic<uint64_t>> actorSeen;
+  std::vector<std::atomic<uint64_t>> movieSeen;
+  std::vector<int> beforeActor;
+  std::vector<int> beforeMovie;
+  std::vector<int> frontier;
+  std::vector<std::vector<int>> next;    // one next frontier per thread
+  std::vector<searchStats> threadStats;  // one set of counters per thread
+
+  // per-level job shared with the workers
+  int target;
+  std::atomic<size_t> nextChunk;
+  std::atomic<bool> found;
+
+  // worker pool bookkeeping
+  std::vector<std::thread> workers;
+  std::mutex m;
+  std::condition_variable levelReady;
+  std::condition_variable levelDone;
+  unsigned int generation;
+  int running;
+  bool stopping;
+
+  void worker(int id);
+  void expandLevel(int id);
+  void runLevel();
+
+  parallelSearcher(const parallelSearcher& original) = delete;
+  parallelSearcher& operator=(const parallelSearcher& rhs) = delete;
+};
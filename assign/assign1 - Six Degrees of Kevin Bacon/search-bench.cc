@@ -0,0 +1,135 @@
+/**
+ * File: search-bench.cc
+ * ---------------------
+ * Runs each of the search strategies over the same list of actor pairs and
+ * reports path length, expanded-node counts and wall time for each, so the
+ * strategies can be compared side by side.
+ *
+ * Pairs are read from the file named on the command line, one pair per line
+ * with the two names separated by a tab.  Without a file, a built-in list
+ * of pairs is used.  The landmark-pruned searches are included whenever a
+ * landmarks file has been built (see landmark-build).
+ */
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <utility>
+#include <functional>
+#include "imdb.h"
+#include "imdb-graph.h"
+#include "path.h"
+#include "search-engine.h"
+#include "landmark-oracle.h"
+using namespace std;
+
+static const int kWrongArgumentCount = 1;
+static const int kDatabaseNotFound = 2;
+static const int kPairsFileNotFound = 3;
+
+static const pair<string, string> kDefaultPairs[] = {
+	{"Meryl Streep", "Jack Nicholson (I)"},
+	{"Mary Tyler Moore", "Red Buttons"},
+	{"Jerry Cain", "Kevin Bleyer"},
+	{"Kevin Bacon (I)", "Meryl Streep"},
+	{"Jerry Cain", "Kevin Bacon (I)"},
+};
+
+struct strategy {
+	const char *name;
+	function<bool(const string& source, const string& target, path& p, searchStats& stats)> search;
+};
+
+static bool readPairs(const char *filename, vector<pair<string, string>>& pairs) {
+	ifstream infile(filename);
+	if (!infile) return false;
+	string line;
+	while (getline(infile, line)) {
+		size_t tab = line.find('\t');
+		if (tab == string::npos) continue;
+		pairs.push_back(make_pair(line.substr(0, tab), line.substr(tab + 1)));
+	}
+	return true;
+}
+
+static void runStrategy(const strategy& s, const pair<string, string>& actors) {
+	path p(actors.first);
+	searchStats stats;
+	auto start = chrono::steady_clock::now();
+	bool found = s.search(actors.first, actors.second, p, stats);
+	auto stop = chrono::steady_clock::now();
+	double ms = chrono::duration<double, milli>(stop - start).count();
+	cout << "  " << left << setw(16) << s.name << right
+	     << setw(8) << (found ? to_string(p.getLength()) : string("-"))
+	     << setw(12) << stats.actorsExpanded
+	     << setw(12) << stats.filmsExpanded
+	     << setw(12) << fixed << setprecision(1) << ms << endl;
+}
+
+int main(int argc, char *argv[]) {
+	if (argc > 2) {
+		cerr << "Usage: " << argv[0] << " [<pairs-file>]" << endl;
+		return kWrongArgumentCount;
+	}
+	vector<pair<string, string>> pairs;
+	if (argc == 2) {
+		if (!readPairs(argv[1], pairs)) {
+			cerr << "Can't read pairs from " << argv[1] << endl;
+			return kPairsFileNotFound;
+		}
+	} else {
+		pairs.assign(begin(kDefaultPairs), end(kDefaultPairs));
+	}
+
+	imdb db(kIMDBDataDirectory);
+	if (!db.good()) {
+		cerr << "Data directory not found!  Aborting..." << endl;
+		return kDatabaseNotFound;
+	}
+
+	auto start = chrono::steady_clock::now();
+	imdbGraph graph(db);
+	graphSearchState state(graph);
+	auto stop = chrono::steady_clock::now();
+	cout << "Built compact graph of " << graph.getActorCount() << " actors and " << graph.getMovieCount()
+	     << " movies in " << fixed << setprecision(1) << chrono::duration<double, milli>(stop - start).count()
+	     << " ms." << endl << endl;
+
+	vector<strategy> strategies = {
+		{"unidirectional", [&](const string& source, const string& target, path& p, searchStats& stats) {
+			return unidirectionalSearch(db, source, target, p, stats);
+		}},
+		{"bidirectional", [&](const string& source, const string& target, path& p, searchStats& stats) {
+			return bidirectionalSearch(db, source, target, p, stats);
+		}},
+		{"csr-uni", [&](const string& source, const string& target, path& p, searchStats& stats) {
+			return graphSearch(graph, source, target, false, state, p, stats);
+		}},
+		{"csr-bi", [&](const string& source, const string& target, path& p, searchStats& stats) {
+			return graphSearch(graph, source, target, true, state, p, stats);
+		}},
+	};
+
+	landmarkOracle landmarks(kIMDBDataDirectory);
+	if (landmarks.good()) {
+		strategies.push_back({"alt-uni", [&](const string& source, const string& target, path& p, searchStats& stats) {
+			return graphSearch(graph, source, target, false, state, p, stats, &landmarks);
+		}});
+		strategies.push_back({"alt-bi", [&](const string& source, const string& target, path& p, searchStats& stats) {
+			return graphSearch(graph, source, target, true, state, p, stats, &landmarks);
+		}});
+	}
+
+	for (const pair<string, string>& actors : pairs) {
+		cout << actors.first << " -> " << actors.second << endl;
+		cout << "  " << left << setw(16) << "strategy" << right << setw(8) << "length"
+		     << setw(12) << "actors" << setw(12) << "films" << setw(12) << "ms" << endl;
+		for (const strategy& s : strategies) {
+			runStrategy(s, actors);
+		}
+		cout << endl;
+	}
+	return 0;
+}
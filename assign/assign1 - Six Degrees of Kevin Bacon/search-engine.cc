@@ -0,0 +1,274 @@
+#include "search-engine.h"
+#include <unordered_map>
+#include <map>
+#include <queue>
+#include <vector>
+#include <algorithm>
+#include <string_view>
+using namespace std;
+
+/**
+ * The string-based searches key everything by string_views into the imdb's
+ * data files (the only exceptions being the source and target, which point
+ * into the caller's strings), so they walk credits and casts without copying
+ * a single title or name.  Only the final path is deep-copied.
+ */
+typedef unordered_map<string_view, filmView> actorMap;
+typedef map<filmView, string_view> filmMap;
+
+/**
+ * Rebuilds the path from source to target by walking the predecessor maps
+ * backwards from the target, then reversing the result.
+ */
+static void buildPath(string_view source, string_view target, actorMap& before_actor,
+		filmMap& before_film, path& p) {
+	path reversed{string(target)};
+	string_view actor = target;
+	while (actor != source) {
+		filmView movie = before_actor[actor];
+		actor = before_film[movie];
+		reversed.addConnection(movie.toFilm(), string(actor));
+	}
+	reversed.reverse();
+	p = reversed;
+}
+
+bool unidirectionalSearch(const imdb& db, const string& source, const string& target, path& p, searchStats& stats) {
+	actorMap before_actor;
+	filmMap before_film;
+	queue<string_view> q;
+	q.push(source);
+	filmView dummy {"dummy", 1900};
+	before_actor[source] = dummy;
+	int level = kMaxPathLength + 1;
+
+	while (q.size() > 0 && level-- > 0) {
+		size_t length = q.size();
+		for (size_t i = 0; i < length; i++) {
+			string_view actor = q.front();
+			q.pop();
+			if (actor == target) {
+				buildPath(source, target, before_actor, before_film, p);
+				return true;
+			}
+			creditList movies;
+			db.getCredits(actor, movies);
+			stats.actorsExpanded++;
+			for (filmView movie : movies) {
+				if (before_film.find(movie) == before_film.end()) {
+					before_film[movie] = actor;
+					castList actors;
+					db.getCast(movie, actors);
+					stats.filmsExpanded++;
+					for (string_view next_actor : actors) {
+						if (before_actor.find(next_actor) == before_actor.end()) {
+							before_actor[next_actor] = movie;
+							q.push(next_actor);
+						}
+					}
+				}
+			}
+		}
+	}
+	return false;
+}
+
+/**
+ * One half of a bidirectional search: its own queue and predecessor maps,
+ * plus the number of levels it has expanded so far.  Every actor is checked
+ * against the other half the moment it's discovered, so the first actor
+ * the two halves share lies on a shortest path.
+ */
+struct searchSide {
+	queue<string_view> frontier;
+	actorMap before_actor;
+	filmMap before_film;
+	int level;
+
+	searchSide(string_view root) : level(0) {
+		frontier.push(root);
+		before_actor[root] = filmView {"dummy", 1900};
+	}
+};
+
+/**
+ * Expands every actor currently in side's frontier by one level.  Returns
+ * true and records the meeting actor as soon as an actor already reached
+ * by the other side is discovered.
+ */
+static bool expandLevel(const imdb& db, searchSide& side, const searchSide& other, searchStats& stats, string_view& meet) {
+	size_t length = side.frontier.size();
+	side.level++;
+	for (size_t i = 0; i < length; i++) {
+		string_view actor = side.frontier.front();
+		side.frontier.pop();
+		creditList movies;
+		db.getCredits(actor, movies);
+		stats.actorsExpanded++;
+		for (filmView movie : movies) {
+			if (side.before_film.find(movie) != side.before_film.end()) continue;
+			side.before_film[movie] = actor;
+			castList actors;
+			db.getCast(movie, actors);
+			stats.filmsExpanded++;
+			for (string_view next_actor : actors) {
+				if (side.before_actor.find(next_actor) != side.before_actor.end()) continue;
+				side.before_actor[next_actor] = movie;
+				side.frontier.push(next_actor);
+				if (other.before_actor.find(next_actor) != other.before_actor.end()) {
+					meet = next_actor;
+					return true;
+				}
+			}
+		}
+	}
+	return false;
+}
+
+bool bidirectionalSearch(const imdb& db, const string& source, const string& target, path& p, searchStats& stats) {
+	if (source == target) {
+		p = path(source);
+		return true;
+	}
+
+	searchSide forward(source), backward(target);
+	string_view meet;
+	bool found = false;
+	while (!found && !forward.frontier.empty() && !backward.frontier.empty() &&
+			forward.level + backward.level < kMaxPathLength) {
+		if (forward.frontier.size() <= backward.frontier.size()) {
+			found = expandLevel(db, forward, backward, stats, meet);
+		} else {
+			found = expandLevel(db, backward, forward, stats, meet);
+		}
+	}
+	if (!found) return false;
+
+	// source -> meet comes from the forward maps, meet -> target from the backward
+	// maps, which already point toward the target
+	buildPath(source, meet, forward.before_actor, forward.before_film, p);
+	string_view actor = meet;
+	while (actor != target) {
+		filmView movie = backward.before_actor[actor];
+		actor = backward.before_film[movie];
+		p.addConnection(movie.toFilm(), string(actor));
+	}
+	return true;
+}
+
+static void initSide(graphSearchState::side& s, const imdbGraph& graph) {
+	s.actorSeen.assign((graph.getActorCount() + 63) / 64, 0);
+	s.movieSeen.assign((graph.getMovieCount() + 63) / 64, 0);
+	s.beforeActor.resize(graph.getActorCount());
+	s.beforeMovie.resize(graph.getMovieCount());
+	s.level = 0;
+}
+
+graphSearchState::graphSearchState(const imdbGraph& graph) {
+	initSide(forward, graph);
+	initSide(backward, graph);
+}
+
+static inline bool isBitSet(const vector<uint64_t>& bits, int i) {
+	return (bits[i >> 6] >> (i & 63)) & 1;
+}
+
+static inline void setBit(vector<uint64_t>& bits, int i) {
+	bits[i >> 6] |= uint64_t(1) << (i & 63);
+}
+
+static void resetSide(graphSearchState::side& s, int root) {
+	fill(s.actorSeen.begin(), s.actorSeen.end(), 0);
+	fill(s.movieSeen.begin(), s.movieSeen.end(), 0);
+	s.frontier.clear();
+	s.next.clear();
+	s.frontier.push_back(root);
+	setBit(s.actorSeen, root);
+	s.level = 0;
+}
+
+/**
+ * Graph counterpart of expandLevel above: expands side's whole frontier by one
+ * level, stopping as soon as it discovers an actor the other side has seen.
+ * With an oracle, newly discovered actors that can't lie on a path of at most
+ * limit films to goal (the other side's root) are marked seen but never expanded.
+ */
+static bool expandGraphLevel(const imdbGraph& graph, graphSearchState::side& side,
+		const graphSearchState::side& other, const landmarkOracle *oracle, int goal, int limit,
+		searchStats& stats, int& meet) {
+	side.level++;
+	side.next.clear();
+	for (int actor : side.frontier) {
+		stats.actorsExpanded++;
+		for (const int *movie = graph.creditsBegin(actor); movie != graph.creditsEnd(actor); movie++) {
+			if (isBitSet(side.movieSeen, *movie)) continue;
+			setBit(side.movieSeen, *movie);
+			side.beforeMovie[*movie] = actor;
+			stats.filmsExpanded++;
+			for (const int *costar = graph.castBegin(*movie); costar != graph.castEnd(*movie); costar++) {
+				if (isBitSet(side.actorSeen, *costar)) continue;
+				setBit(side.actorSeen, *costar);
+				side.beforeActor[*costar] = *movie;
+				if (oracle != NULL && side.level + oracle->lowerBound(*costar, goal) > limit) continue;
+				side.next.push_back(*costar);
+				if (isBitSet(other.actorSeen, *costar)) {
+					meet = *costar;
+					return true;
+				}
+			}
+		}
+	}
+	side.frontier.swap(side.next);
+	return false;
+}
+
+bool graphSearch(const imdbGraph& graph, const string& source, const string& target,
+		bool bidirectional, graphSearchState& state, path& p, searchStats& stats,
+		const landmarkOracle *oracle, int maxLength) {
+	int from = graph.findActor(source);
+	int to = graph.findActor(target);
+	if (from == -1 || to == -1) return false;
+	if (from == to) {
+		p = path(source);
+		return true;
+	}
+	int limit = min(maxLength, kMaxPathLength);
+	if (oracle != NULL) {
+		if (oracle->lowerBound(from, to) > limit) return false;
+		limit = min(limit, oracle->upperBound(from, to));
+	}
+
+	// a one-sided search is a two-sided one whose backward half never grows
+	graphSearchState::side& forward = state.forward;
+	graphSearchState::side& backward = state.backward;
+	resetSide(forward, from);
+	resetSide(backward, to);
+	int meet = -1;
+	bool found = false;
+	while (!found && !forward.frontier.empty() && !backward.frontier.empty() &&
+			forward.level + backward.level < limit) {
+		if (!bidirectional || forward.frontier.size() <= backward.frontier.size()) {
+			found = expandGraphLevel(graph, forward, backward, oracle, to, limit, stats, meet);
+		} else {
+			found = expandGraphLevel(graph, backward, forward, oracle, from, limit, stats, meet);
+		}
+	}
+	if (!found) return false;
+
+	vector<int> legs; // movies from meet back to the source
+	for (int actor = meet; actor != from; actor = forward.beforeMovie[legs.back()]) {
+		legs.push_back(forward.beforeActor[actor]);
+	}
+	p = path(source);
+	for (size_t i = legs.size(); i > 0; i--) {
+		int movie = legs[i - 1];
+		int actor = (i == 1) ? meet : forward.beforeMovie[legs[i - 2]];
+		p.addConnection(graph.getMovie(movie), graph.getActorName(actor));
+	}
+	for (int actor = meet; actor != to; ) {
+		int movie = backward.beforeActor[actor];
+		actor = backward.beforeMovie[movie];
+		p.addConnection(graph.getMovie(movie), graph.getActorName(actor));
+	}
+	return true;
+}
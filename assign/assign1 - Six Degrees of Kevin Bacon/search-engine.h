@@ -0,0 +1,110 @@
+#pragma once
+#include "imdb.h"
+#include "imdb-graph.h"
+#include "landmark-oracle.h"
+#include "path.h"
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/**
+ * Constant: kMaxPathLength
+ * ------------------------
+ * The longest path (in number of films) any of the search routines
+ * will report.  Anything further apart than this is reported as
+ * unreachable.
+ */
+static const int kMaxPathLength = 6;
+
+/**
+ * Convenience struct: searchStats
+ * -------------------------------
+ * Counters updated by the search routines so that different strategies
+ * can be compared on the same actor pairs.  actorsExpanded counts the
+ * getCredits calls, filmsExpanded counts the getCast calls.
+ */
+struct searchStats {
+  size_t actorsExpanded;
+  size_t filmsExpanded;
+
+  searchStats() : actorsExpanded(0), filmsExpanded(0) {}
+};
+
+/**
+ * Function: unidirectionalSearch
+ * ------------------------------
+ * Breadth-first search that expands outward from the source only, one level
+ * at a time, until the target is dequeued or kMaxPathLength levels have been
+ * explored.  On success, p is replaced by a shortest path from source to target.
+ *
+ * @param db the imdb being searched.
+ * @param source the actor/actress the path should start with.
+ * @param target the actor/actress the path should end with.
+ * @param p the path to be overwritten when a connection is found.
+ * @param stats the counters to be incremented as actors and films are expanded.
+ * @return true if and only if a path of length kMaxPathLength or less was found.
+ */
+bool unidirectionalSearch(const imdb& db, const std::string& source, const std::string& target,
+                          path& p, searchStats& stats);
+
+/**
+ * Function: bidirectionalSearch
+ * -----------------------------
+ * Breadth-first search that grows one frontier from the source and another from
+ * the target, always expanding whichever frontier is currently smaller by one full
+ * level.  When the two meet, the halves are joined into a single shortest path.
+ * Parameters and return value are the same as for unidirectionalSearch.
+ */
+bool bidirectionalSearch(const imdb& db, const std::string& source, const std::string& target,
+                         path& p, searchStats& stats);
+
+/**
+ * Convenience struct: graphSearchState
+ * ------------------------------------
+ * Scratch space for searches over an imdbGraph: one visited bitset per
+ * actor and per movie, the predecessor of everything visited, and the
+ * current and next frontiers, for each of the two search directions.
+ * Everything is sized for the graph once, so a state can be reused across
+ * any number of searches without allocating.
+ */
+struct graphSearchState {
+  struct side {
+    std::vector<uint64_t> actorSeen;
+    std::vector<uint64_t> movieSeen;
+    std::vector<int> beforeActor; // movie through which each visited actor was reached
+    std::vector<int> beforeMovie; // actor through which each visited movie was reached
+    std::vector<int> frontier;
+    std::vector<int> next;
+    int level;
+  } forward, backward;
+
+  graphSearchState(const imdbGraph& graph);
+};
+
+/**
+ * Function: graphSearch
+ * ---------------------
+ * Same contract as unidirectionalSearch and bidirectionalSearch, but runs over
+ * an imdbGraph, so the traversal works entirely on integer ids and bitsets and
+ * names are only resolved to build the final path.
+ *
+ * When a landmarkOracle is supplied, its bounds are used the way A* uses an
+ * admissible heuristic: the search gives up immediately if the lower bound
+ * between source and target exceeds maxLength, never searches deeper than the
+ * upper bound, and never expands an actor whose depth plus lower bound to the
+ * far end exceeds that limit, since no short enough path can go through it.
+ *
+ * @param graph the compact graph being searched.
+ * @param source the actor/actress the path should start with.
+ * @param target the actor/actress the path should end with.
+ * @param bidirectional true to grow frontiers from both ends, false to search from the source only.
+ * @param state scratch space previously constructed for the same graph.
+ * @param p the path to be overwritten when a connection is found.
+ * @param stats the counters to be incremented as actors and films are expanded.
+ * @param oracle the landmark distances used to prune the search, or NULL.
+ * @param maxLength the longest path worth reporting, at most kMaxPathLength.
+ * @return true if and only if a path of length maxLength or less was found.
+ */
+bool graphSearch(const imdbGraph& graph, const std::string& source, const std::string& target,
+                 bool bidirectional, graphSearchState& state, path& p, searchStats& stats,
+                 const landmarkOracle *oracle = NULL, int maxLength = kMaxPathLength);
@@ -1,80 +1,224 @@
 #include <iostream>
 #include <utility>
+#include <algorithm>
+#include <unistd.h>
+#include <stdlib.h>
 #include "path.h"
-#include <unordered_map>
-#include <map>
-#include <queue>
 #include "imdb.h"
+#include "imdb-graph.h"
+#include "search-engine.h"
+#include "parallel-search.h"
+#include "batch-search.h"
+#include "landmark-oracle.h"
+#include "shortest-paths.h"
 using namespace std;
 
 static const int kWrongArgumentCount = 1;
 static const int kDatabaseNotFound = 2;
+static const int kPortUnavailable = 3;
 
-bool bfs(const imdb &db, const string &source, const string &target, unordered_map<string, film> &before_actor, map<film, string> &before_film) {
-	queue<string> q;
-	q.push(source);
-	film dummy {"dummy", 1900};
-	before_actor[source] = dummy;
-	int level = 7;
+static void printUsage(const char *progname) {
+	cerr << "Usage: " << progname << " [-b] [-g] [-l] [-m <policy>] [-j <threads>] [-w <films>] [-a | -r <count>] <source-actor> <target-actor>" << endl;
+	cerr << "       " << progname << " -s [-b] [-l] [-m <policy>] [-j <threads>] [-p <port>]" << endl;
+	cerr << "  -b    search from both actors at once (bidirectional BFS)" << endl;
+	cerr << "  -m    load the database with this policy: a comma-separated list of lazy," << endl;
+	cerr << "        populate, willneed, hugepages, random and warmup (see imdb-load-bench)" << endl;
+	cerr << "  -g    build the compact integer-id graph first and search that" << endl;
+	cerr << "  -l    prune the compact graph search with the landmarks file (see landmark-build)" << endl;
+	cerr << "  -w    only report whether the two are within this many films of each other," << endl;
+	cerr << "        using the landmarks file to answer without searching when it can" << endl;
+	cerr << "  -a    print every shortest path, not just one" << endl;
+	cerr << "  -r    print this many shortest paths, those with the most recent films first" << endl;
+	cerr << "  -j    search the compact graph with this many threads sharing each level" << endl;
+	cerr << "        (with -s, this many queries are searched at once instead)" << endl;
+	cerr << "  -s    answer tab-separated source/target pairs read from stdin (or from" << endl;
+	cerr << "        each connection on the -p port), and report latencies to stderr" << endl;
+}
 
-	while (q.size() > 0 && level-- > 0) {
-		size_t length = q.size();
-		for (size_t i = 0; i < length; i++) {
-			string actor = q.front();
-			q.pop();
-			if (actor == target) {
-				return true;
-			}
-			vector<film> movies;
-			db.getCredits(actor, movies);
-			for (auto movie : movies) {
-				if (before_film.find(movie) == before_film.end()) {
-					before_film[movie] = actor;
-					vector<string> actors;
-					db.getCast(movie, actors);
-					for (auto next_actor : actors) {
-						if (before_actor.find(next_actor) == before_actor.end()) {
-							before_actor[next_actor] = movie;
-							q.push(next_actor);
-						}
-					}
-				}
-			}
-		}
+/**
+ * Keeps one imdb and one compact graph alive for a whole stream of queries,
+ * read from stdin or, if a port is given, from every connection to it.
+ */
+static int serveQueries(const imdb& db, bool bidirectional, const landmarkOracle *oracle, int numWorkers, int port) {
+	imdbGraph graph(db);
+	batchSearcher searcher(graph, numWorkers, bidirectional, oracle);
+	if (port != 0) {
+		searcher.serveOnPort(port, cerr);
+		cerr << "Couldn't listen on port " << port << "." << endl;
+		return kPortUnavailable;
+	}
+	searcher.serve(stdin, stdout);
+	searcher.reportLatencies(cerr);
+	return 0;
+}
+
+/**
+ * Decides whether two actors are within the specified number of films of each
+ * other, asking the landmark bounds first and only searching if they can't
+ * settle it.
+ */
+static bool withinDistance(const imdb& db, const landmarkOracle *oracle, bool bidirectional,
+		const string& source, const string& target, int films) {
+	int from = db.findActor(source);
+	int to = db.findActor(target);
+	if (from == -1 || to == -1) return false;
+	if (oracle != NULL) {
+		if (oracle->lowerBound(from, to) > films) return false;
+		if (oracle->upperBound(from, to) <= films) return true;
+	}
+	imdbGraph graph(db);
+	graphSearchState state(graph);
+	path p(source);
+	searchStats stats;
+	return graphSearch(graph, source, target, bidirectional, state, p, stats, oracle, films);
+}
+
+/**
+ * Prints how many shortest paths connect the two actors, followed by either
+ * all of them (when count is 0) or the count most recent ones.
+ */
+static void printShortestPaths(const imdb& db, const string& source, const string& target, int count) {
+	imdbGraph graph(db);
+	shortestPaths paths(graph);
+	if (!paths.search(source, target)) {
+		cout << "No path between those two people could be found." << endl;
+		return;
+	}
+	uint64_t total = paths.countPaths();
+	cout << total << (total == 1 ? " shortest path" : " shortest paths") << " of " << paths.getLength()
+	     << (paths.getLength() == 1 ? " film" : " films") << " connect" << (total == 1 ? "s " : " ")
+	     << source << " and " << target << "." << endl << endl;
+	if (count == 0) {
+		path p(source);
+		while (paths.nextPath(p)) cout << p << endl;
+	} else {
+		for (const path& p : paths.mostRecentPaths(count)) cout << p << endl;
 	}
-	return false;
 }
 
 int main(int argc, char *argv[]) {
-	if (argc != 3) {
-		cerr << "Usage: " << argv[0] << " <source-actor> <target-actor>" << endl;
+	bool bidirectional = false;
+	bool compact = false;
+	int numThreads = 0;
+	bool batch = false;
+	int port = 0;
+	bool useLandmarks = false;
+	int within = 0;
+	unsigned int loadPolicy = kLoadLazy;
+	int enumerate = -1;
+	int opt;
+	while ((opt = getopt(argc, argv, "bgj:sp:lw:m:ar:")) != -1) {
+		switch (opt) {
+			case 'b':
+				bidirectional = true;
+				break;
+			case 'g':
+				compact = true;
+				break;
+			case 'j':
+				numThreads = atoi(optarg);
+				if (numThreads < 1) {
+					printUsage(argv[0]);
+					return kWrongArgumentCount;
+				}
+				break;
+			case 's':
+				batch = true;
+				break;
+			case 'l':
+				useLandmarks = true;
+				break;
+			case 'a':
+				enumerate = 0;
+				break;
+			case 'r':
+				enumerate = atoi(optarg);
+				if (enumerate < 1) {
+					printUsage(argv[0]);
+					return kWrongArgumentCount;
+				}
+				break;
+			case 'm':
+				if (!parseLoadPolicy(optarg, loadPolicy)) {
+					printUsage(argv[0]);
+					return kWrongArgumentCount;
+				}
+				break;
+			case 'w':
+				within = atoi(optarg);
+				if (within < 1 || within > kMaxPathLength) {
+					printUsage(argv[0]);
+					return kWrongArgumentCount;
+				}
+				break;
+			case 'p':
+				port = atoi(optarg);
+				if (port < 1 || port > 65535) {
+					printUsage(argv[0]);
+					return kWrongArgumentCount;
+				}
+				break;
+			default:
+				printUsage(argv[0]);
+				return kWrongArgumentCount;
+		}
+	}
+	if (argc - optind != (batch ? 0 : 2) || (port != 0 && !batch)) {
+		printUsage(argv[0]);
 		return kWrongArgumentCount;
 	}
-	imdb db(kIMDBDataDirectory);
+	imdb db(kIMDBDataDirectory, true, loadPolicy);
 	if (!db.good()) {
 		cerr << "Data directory not found!  Aborting..." << endl; 
 		return kDatabaseNotFound;
 	}
-	string source = argv[1];
-	string target = argv[2];
+	landmarkOracle landmarks(kIMDBDataDirectory);
+	const landmarkOracle *oracle = NULL;
+	if (useLandmarks || within > 0) {
+		if (landmarks.good()) {
+			oracle = &landmarks;
+		} else if (useLandmarks) {
+			cerr << "No usable landmarks file; searching without it." << endl;
+		}
+	}
+	if (batch) return serveQueries(db, bidirectional, oracle, max(1, numThreads), port);
+	string source = argv[optind];
+	string target = argv[optind + 1];
 
 	if (source == target) {
 		cerr << "Maybe try different two people." << endl;
 	}
 
-	unordered_map<string, film> before_actor;
-	map<film, string> before_film;
+	if (within > 0) {
+		bool close = withinDistance(db, oracle, bidirectional, source, target, within);
+		cout << source << " and " << target << (close ? " are" : " are not") << " within " << within
+		     << (within == 1 ? " film" : " films") << " of each other." << endl;
+		return 0;
+	}
+
+	if (enumerate >= 0) {
+		printShortestPaths(db, source, target, enumerate);
+		return 0;
+	}
 
-	bool flag = bfs(db, source, target, before_actor, before_film);
+	path p(source);
+	searchStats stats;
+	bool flag;
+	if (numThreads > 0) {
+		imdbGraph graph(db);
+		parallelSearcher searcher(graph, numThreads);
+		flag = searcher.search(source, target, p, stats);
+	} else if (compact || oracle != NULL) {
+		imdbGraph graph(db);
+		graphSearchState state(graph);
+		flag = graphSearch(graph, source, target, bidirectional, state, p, stats, oracle);
+	} else if (bidirectional) {
+		flag = bidirectionalSearch(db, source, target, p, stats);
+	} else {
+		flag = unidirectionalSearch(db, source, target, p, stats);
+	}
 	
 	if (flag) {
-		path p(target);
-		while (target != source) {
-			film movie = before_actor[target];
-			target = before_film[movie];
-			p.addConnection(movie, target);
-		}
-		p.reverse();
 		cout << p << endl;
 	} else {
 		cout << "No path between those two people could be found." << endl;
@@ -83,4 +227,3 @@ int main(int argc, char *argv[]) {
 
 	return 0;
 }
-
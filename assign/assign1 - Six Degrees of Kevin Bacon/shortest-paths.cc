@@ -0,0 +1,182 @@
+#include "shortest-paths.h"
+#include "search-engine.h"
+#include <algorithm>
+#include <queue>
+using namespace std;
+
+static const uint8_t kUnseen = 255;
+
+shortestPaths::shortestPaths(const imdbGraph& graph) : graph(graph), from(-1), to(-1), length(0),
+	actorLevel(graph.getActorCount(), kUnseen), movieLevel(graph.getMovieCount(), kUnseen),
+	pathCount(graph.getActorCount()), bestYears(graph.getActorCount()), exhausted(true) {}
+
+bool shortestPaths::search(const string& source, const string& target) {
+	this->source = source;
+	from = graph.findActor(source);
+	to = graph.findActor(target);
+	length = 0;
+	stack.clear();
+	exhausted = true;
+	if (from == -1 || to == -1) return false;
+
+	fill(actorLevel.begin(), actorLevel.end(), kUnseen);
+	fill(movieLevel.begin(), movieLevel.end(), kUnseen);
+	fill(pathCount.begin(), pathCount.end(), 0);
+	fill(bestYears.begin(), bestYears.end(), -1);
+
+	// every level is finished even once the target turns up, so that all of its predecessors are recorded
+	vector<int> frontier(1, from), next;
+	actorLevel[from] = 0;
+	for (int level = 0; actorLevel[to] == kUnseen && !frontier.empty() && level < kMaxPathLength; level++) {
+		next.clear();
+		for (int actor : frontier) {
+			for (const int *movie = graph.creditsBegin(actor); movie != graph.creditsEnd(actor); movie++) {
+				if (movieLevel[*movie] != kUnseen) continue;
+				movieLevel[*movie] = level;
+				for (const int *costar = graph.castBegin(*movie); costar != graph.castEnd(*movie); costar++) {
+					if (actorLevel[*costar] != kUnseen) continue;
+					actorLevel[*costar] = level + 1;
+					next.push_back(*costar);
+				}
+			}
+		}
+		frontier.swap(next);
+	}
+	if (actorLevel[to] == kUnseen) return false;
+
+	length = actorLevel[to];
+	stack.push_back({to, graph.creditsBegin(to), NULL});
+	exhausted = false;
+	return true;
+}
+
+/**
+ * Advances f to its actor's next (movie, costar) predecessor pair, returning
+ * false once there are no more.  Only movies and costars one level closer to
+ * the source qualify.
+ */
+bool shortestPaths::nextPredecessor(frame& f) const {
+	int level = actorLevel[f.actor] - 1;
+	const int *credits = graph.creditsEnd(f.actor);
+	if (f.costar != NULL) f.costar++;
+	while (true) {
+		if (f.costar == NULL) {
+			while (f.movie != credits && movieLevel[*f.movie] != level) f.movie++;
+			if (f.movie == credits) return false;
+			f.costar = graph.castBegin(*f.movie);
+		}
+		const int *cast = graph.castEnd(*f.movie);
+		while (f.costar != cast && actorLevel[*f.costar] != level) f.costar++;
+		if (f.costar != cast) return true;
+		f.movie++;
+		f.costar = NULL;
+	}
+}
+
+uint64_t shortestPaths::countPathsTo(int actor) {
+	if (actor == from) return 1;
+	if (pathCount[actor] != 0) return pathCount[actor];
+	uint64_t count = 0;
+	frame f = {actor, graph.creditsBegin(actor), NULL};
+	while (nextPredecessor(f)) {
+		uint64_t paths = countPathsTo(*f.costar);
+		count = (count > UINT64_MAX - paths) ? UINT64_MAX : count + paths;
+	}
+	return pathCount[actor] = count;
+}
+
+uint64_t shortestPaths::countPaths() {
+	if (to == -1 || actorLevel[to] == kUnseen) return 0;
+	return countPathsTo(to);
+}
+
+path shortestPaths::buildPath() const {
+	path p(source);
+	for (size_t i = stack.size() - 1; i > 0; i--) {
+		p.addConnection(graph.getMovie(*stack[i - 1].movie), graph.getActorName(stack[i - 1].actor));
+	}
+	return p;
+}
+
+bool shortestPaths::nextPath(path& p) {
+	if (exhausted) return false;
+	if (from == to) {
+		exhausted = true;
+		p = path(source);
+		return true;
+	}
+
+	// the stack runs from the target back to the source, so the last path ended at the source
+	if (stack.back().actor == from) stack.pop_back();
+	while (!stack.empty()) {
+		frame& top = stack.back();
+		if (!nextPredecessor(top)) {
+			stack.pop_back();
+			continue;
+		}
+		int actor = *top.costar;
+		stack.push_back({actor, graph.creditsBegin(actor), NULL});
+		if (actor == from) {
+			p = buildPath();
+			return true;
+		}
+	}
+	exhausted = true;
+	return false;
+}
+
+int shortestPaths::bestYearsTo(int actor) {
+	if (actor == from) return 0;
+	if (bestYears[actor] != -1) return bestYears[actor];
+	int best = 0;
+	frame f = {actor, graph.creditsBegin(actor), NULL};
+	while (nextPredecessor(f)) {
+		best = max(best, graph.getMovieYear(*f.movie) + bestYearsTo(*f.costar));
+	}
+	return bestYears[actor] = best;
+}
+
+vector<path> shortestPaths::mostRecentPaths(int count) {
+	vector<path> paths;
+	if (to == -1 || actorLevel[to] == kUnseen || count <= 0) return paths;
+	if (from == to) {
+		paths.push_back(path(source));
+		return paths;
+	}
+
+	// a partial path runs from the target back to some actor; movie links that actor to its parent's
+	struct partial {
+		int actor;
+		int movie;
+		int parent;
+		int years;
+	};
+	vector<partial> partials;
+	// (years plus the best possible for the rest, index into partials): among
+	// equally good partials the newest, and so deepest, is taken first, so ties
+	// finish one path at a time rather than growing every partial in step
+	typedef pair<int, int> entry;
+	priority_queue<entry> queue;
+	partials.push_back({to, -1, -1, 0});
+	queue.push(entry(bestYearsTo(to), 0));
+	while (!queue.empty() && (int) paths.size() < count) {
+		int index = queue.top().second;
+		queue.pop();
+		partial current = partials[index];
+		if (current.actor == from) {
+			path p(source);
+			for (int i = index; partials[i].parent != -1; i = partials[i].parent) {
+				p.addConnection(graph.getMovie(partials[i].movie), graph.getActorName(partials[partials[i].parent].actor));
+			}
+			paths.push_back(p);
+			continue;
+		}
+		frame f = {current.actor, graph.creditsBegin(current.actor), NULL};
+		while (nextPredecessor(f)) {
+			int years = current.years + graph.getMovieYear(*f.movie);
+			partials.push_back({*f.costar, *f.movie, index, years});
+			queue.push(entry(years + bestYearsTo(*f.costar), (int) (partials.size() - 1)));
+		}
+	}
+	return paths;
+}
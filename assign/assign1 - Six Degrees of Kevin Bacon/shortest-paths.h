@@ -0,0 +1,115 @@
+#pragma once
+#include "imdb-graph.h"
+#include "path.h"
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/**
+ * Class: shortestPaths
+ * --------------------
+ * Finds every shortest path between two actors, not just one.  Rather than a
+ * single predecessor per actor and movie, a search records the breadth-first
+ * level of everything it reaches, one byte per actor and per movie.  That's
+ * all it takes to recover the whole predecessor DAG on demand: the
+ * predecessors of an actor at level d are the (movie, costar) pairs where the
+ * movie is one of the actor's credits at level d - 1 and the costar is in its
+ * cast, also at level d - 1.  Paths are then counted and enumerated by walking
+ * that implicit DAG backwards from the target, so nothing proportional to the
+ * number of paths is ever stored, however many thousands of paths run through
+ * a hub.
+ *
+ * All of the scratch space is sized for the graph once, so a single
+ * shortestPaths can be reused across any number of searches.
+ */
+
+class shortestPaths {
+ public:
+
+/**
+ * Constructor: shortestPaths
+ * --------------------------
+ * @param graph the compact graph to search.  It must outlive the shortestPaths.
+ */
+
+  shortestPaths(const imdbGraph& graph);
+
+/**
+ * Method: search
+ * --------------
+ * Runs a breadth-first search from source until the level holding target has
+ * been completed (or kMaxPathLength levels have been explored), and prepares
+ * to enumerate paths from the beginning.
+ *
+ * @return true if and only if the two are connected by a path of kMaxPathLength films or fewer.
+ */
+
+  bool search(const std::string& source, const std::string& target);
+
+/**
+ * Method: getLength
+ * -----------------
+ * Returns the number of films on each of the shortest paths.
+ */
+
+  int getLength() const { return length; }
+
+/**
+ * Method: countPaths
+ * ------------------
+ * Returns the number of distinct shortest paths (two paths are distinct if
+ * they differ in any actor or any film), computed by dynamic programming over
+ * the DAG.  Saturates at UINT64_MAX rather than overflowing.
+ */
+
+  uint64_t countPaths();
+
+/**
+ * Method: nextPath
+ * ----------------
+ * Overwrites p with the next shortest path, in no particular order, and
+ * returns true, or returns false once every path has been produced.  Only one
+ * path's worth of state is kept between calls.
+ */
+
+  bool nextPath(path& p);
+
+/**
+ * Method: mostRecentPaths
+ * -----------------------
+ * Returns the count shortest paths whose films are the most recent, meaning
+ * those with the largest sum of release years (the same thing as the latest
+ * average year, since every shortest path has the same number of films), with
+ * the most recent first.  Partial paths are expanded best first, guided by the
+ * exact best year sum from the source to every actor, so only the paths that
+ * are returned are ever completed.
+ */
+
+  std::vector<path> mostRecentPaths(int count);
+
+ private:
+  struct frame {
+    int actor;
+    const int *movie;  // current credit of actor
+    const int *costar; // current cast member of *movie, or NULL before the first
+  };
+
+  const imdbGraph& graph;
+  std::string source;
+  int from, to;
+  int length;
+  std::vector<uint8_t> actorLevel;
+  std::vector<uint8_t> movieLevel;
+  std::vector<uint64_t> pathCount;  // paths from the source to each actor, once computed
+  std::vector<int> bestYears;       // largest year sum from the source to each actor, or -1
+  std::vector<frame> stack;         // the path being enumerated, from the target back
+  bool exhausted;
+
+  bool nextPredecessor(frame& f) const;
+  uint64_t countPathsTo(int actor);
+  int bestYearsTo(int actor);
+  path buildPath() const;
+
+  shortestPaths(const shortestPaths& original) = delete;
+  shortestPaths& operator=(const shortestPaths& rhs) = delete;
+};
@@ -0,0 +1,134 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "alloc.h"
+#include "inode.h"
+#include "diskimg.h"
+
+#define NICFREE 100
+#define NICINOD 100
+
+/**
+ * The layout of a block that continues the free list.
+ */
+struct freeblock
+{
+	uint16_t nfree;
+	uint16_t free[NICFREE];
+};
+
+static int BadBlock(struct unixfilesystem *fs, int blockNum)
+{
+	return blockNum < INODE_START_SECTOR + fs->superblock.s_isize || blockNum >= fs->superblock.s_fsize;
+}
+
+int alloc_block(struct unixfilesystem *fs)
+{
+	struct filsys *sp = &fs->superblock;
+	if (sp->s_nfree == 0 || sp->s_nfree > NICFREE)
+		return -1;
+	int blockNum = sp->s_free[sp->s_nfree - 1];
+	if (blockNum == 0)
+	{
+		// the end of the list
+		sp->s_nfree = 0;
+		sp->s_fmod = 1;
+		return -1;
+	}
+	// a bad entry stays where it is rather than being dropped from the list
+	if (BadBlock(fs, blockNum))
+		return -1;
+	if (sp->s_nfree == 1)
+	{
+		// blockNum holds the next part of the list
+		char buf[DISKIMG_SECTOR_SIZE];
+		const struct freeblock *next = unixfilesystem_getsector(fs, blockNum, buf);
+		if (next == NULL || next->nfree > NICFREE)
+			return -1;
+		sp->s_nfree = next->nfree;
+		memcpy(sp->s_free, next->free, sizeof(sp->s_free));
+	}
+	else
+	{
+		sp->s_nfree--;
+	}
+	sp->s_fmod = 1;
+	return blockNum;
+}
+
+int alloc_freeblock(struct unixfilesystem *fs, int blockNum)
+{
+	struct filsys *sp = &fs->superblock;
+	if (BadBlock(fs, blockNum))
+		return -1;
+	if (sp->s_nfree == 0)
+	{
+		sp->s_nfree = 1;
+		sp->s_free[0] = 0;
+	}
+	if (sp->s_nfree >= NICFREE)
+	{
+		// the list in the superblock moves out to the block being freed
+		struct freeblock next;
+		char buf[DISKIMG_SECTOR_SIZE];
+		memset(buf, 0, sizeof(buf));
+		next.nfree = sp->s_nfree;
+		memcpy(next.free, sp->s_free, sizeof(next.free));
+		memcpy(buf, &next, sizeof(next));
+		if (diskimg_writesector(fs->dfd, blockNum, buf) != DISKIMG_SECTOR_SIZE)
+			return -1;
+		sp->s_nfree = 0;
+	}
+	sp->s_free[sp->s_nfree++] = blockNum;
+	sp->s_fmod = 1;
+	return 0;
+}
+
+int alloc_inode(struct unixfilesystem *fs)
+{
+	struct filsys *sp = &fs->superblock;
+	struct inode in;
+	while (1)
+	{
+		while (sp->s_ninode > 0 && sp->s_ninode <= NICINOD)
+		{
+			int inumber = sp->s_inode[--sp->s_ninode];
+			sp->s_fmod = 1;
+			if (inode_iget(fs, inumber, &in) == 0 && (in.i_mode & IALLOC) == 0)
+				return inumber;
+			// allocated after all, so try the next one
+		}
+		sp->s_ninode = 0;
+
+		// Refill the cache, scanning round from wherever the last scan stopped.
+		// The cache is a stack, so the inumbers found go in from the top down,
+		// and files created one after another get ascending inumbers.
+		int numInodes = sp->s_isize * (DISKIMG_SECTOR_SIZE / sizeof(struct inode));
+		uint16_t found[NICINOD];
+		int numFound = 0;
+		for (int scanned = 0; scanned < numInodes && numFound < NICINOD; scanned++)
+		{
+			int inumber = fs->inodeRotor + 1;
+			fs->inodeRotor = (fs->inodeRotor + 1) % numInodes;
+			if (inode_iget(fs, inumber, &in) < 0)
+				return -1;
+			if ((in.i_mode & IALLOC) == 0)
+				found[numFound++] = inumber;
+		}
+		if (numFound == 0)
+			return -1;
+		for (int i = 0; i < numFound; i++)
+			sp->s_inode[i] = found[numFound - 1 - i];
+		sp->s_ninode = numFound;
+		sp->s_fmod = 1;
+	}
+}
+
+void alloc_freeinode(struct unixfilesystem *fs, int inumber)
+{
+	struct filsys *sp = &fs->superblock;
+	if (sp->s_ninode >= NICINOD)
+		return;
+	sp->s_inode[sp->s_ninode++] = inumber;
+	sp->s_fmod = 1;
+}
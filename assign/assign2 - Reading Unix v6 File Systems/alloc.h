@@ -0,0 +1,47 @@
+#ifndef _ALLOC_H_
+#define _ALLOC_H_
+
+#include "unixfilesystem.h"
+
+/**
+ * Block and inode allocation, done the way Unix v6 does it (alloc.c).
+ *
+ * Free blocks: the superblock holds up to 100 free block numbers in s_free,
+ * s_nfree of them in use.  When they run out, the last one taken names a
+ * block holding the next 100 (its first word is their count, followed by the
+ * numbers themselves), and a block number of 0 marks the end of the list.
+ *
+ * Free inodes: the superblock caches up to 100 free inumbers in s_inode.
+ * When they run out, the inode area is scanned for unallocated inodes.
+ *
+ * Every change to the lists sets the superblock's s_fmod flag, so that
+ * unixfilesystem_sync() writes it back.
+ */
+
+/**
+ * Takes a block off the free list.  Its contents are left as they were.
+ * Returns the block number, or -1 if there are no free blocks or the list is
+ * corrupt.
+ */
+int alloc_block(struct unixfilesystem *fs);
+
+/**
+ * Puts the specified block back on the free list.  Returns 0 on success, -1
+ * on error.
+ */
+int alloc_freeblock(struct unixfilesystem *fs, int blockNum);
+
+/**
+ * Finds an unallocated inode.  The inode itself is left for the caller to
+ * fill in (with IALLOC set) and write with inode_iput.  Returns the inumber,
+ * or -1 if every inode is in use.
+ */
+int alloc_inode(struct unixfilesystem *fs);
+
+/**
+ * Makes the specified inumber available to alloc_inode again.  The inode
+ * should already have been written back with a mode of 0.
+ */
+void alloc_freeinode(struct unixfilesystem *fs, int inumber);
+
+#endif // _ALLOC_H_
@@ -13,42 +13,72 @@
 #include "chksumfile.h"
 #include <openssl/sha.h>
 
-int chksumfile_byinumber(struct unixfilesystem *fs, int inumber, void *chksum)
+// Files are read CHKSUM_RUN_BLOCKS blocks at a time when they aren't mapped,
+// and large files are read ahead CHKSUM_READAHEAD_BLOCKS blocks.
+#define CHKSUM_RUN_BLOCKS 64
+#define CHKSUM_READAHEAD_BLOCKS 256
+
+/**
+ * Hashes a file of a mapped filesystem one block at a time, straight out of
+ * the mapping.
+ */
+static int HashInPlace(struct openfile *file, SHA_CTX *shactx)
 {
-  SHA_CTX shactx;
-  if (!SHA1_Init(&shactx))
+  for (int bno = 0; bno < file->numBlocks; bno++)
   {
-    // An error occurred initializing the SHA1 context.
-    return -1;
+    char buf[DISKIMG_SECTOR_SIZE];
+    const void *data;
+
+    int bytesMoved = file_readblock(file, bno, buf, &data);
+    if (bytesMoved < 0 || !SHA1_Update(shactx, data, bytesMoved))
+      return -1;
   }
+  return 0;
+}
 
-  struct inode in;
-  int err = inode_iget(fs, inumber, &in);
-  if (err < 0)
+/**
+ * Hashes a file CHKSUM_RUN_BLOCKS blocks at a time, so that blocks that are
+ * contiguous on disk are read with a single system call.
+ */
+static int HashInRuns(struct openfile *file, SHA_CTX *shactx)
+{
+  if (file->in.i_mode & ILARG)
+    file_setreadahead(file, CHKSUM_READAHEAD_BLOCKS);
+  for (int bno = 0; bno < file->numBlocks; bno += CHKSUM_RUN_BLOCKS)
   {
-    return err;
+    char buf[CHKSUM_RUN_BLOCKS * DISKIMG_SECTOR_SIZE];
+    int count = file->numBlocks - bno;
+    if (count > CHKSUM_RUN_BLOCKS)
+      count = CHKSUM_RUN_BLOCKS;
+
+    int bytesMoved = file_readblocks(file, bno, count, buf);
+    if (bytesMoved < 0 || !SHA1_Update(shactx, buf, bytesMoved))
+      return -1;
   }
+  return 0;
+}
 
-  if (!(in.i_mode & IALLOC))
+int chksumfile_byinumber(struct unixfilesystem *fs, int inumber, void *chksum)
+{
+  SHA_CTX shactx;
+  if (!SHA1_Init(&shactx))
   {
-    // The inode isn't allocated, so we can't hash it.
+    // An error occurred initializing the SHA1 context.
     return -1;
   }
 
-  int size = inode_getsize(&in);
-  for (int offset = 0; offset < size; offset += DISKIMG_SECTOR_SIZE)
+  struct openfile file;
+  if (file_open(fs, inumber, &file) < 0)
   {
-    char buf[DISKIMG_SECTOR_SIZE];
-    int bno = offset / DISKIMG_SECTOR_SIZE;
-
-    int bytesMoved = file_getblock(fs, inumber, bno, buf);
-    if (bytesMoved < 0)
-      return -1;
-
-    if (!SHA1_Update(&shactx, buf, bytesMoved))
-      return -1;
+    // Either the inode can't be read or it isn't allocated, so we can't hash it.
+    return -1;
   }
 
+  int err = (fs->image != NULL) ? HashInPlace(&file, &shactx) : HashInRuns(&file, &shactx);
+  file_close(&file);
+  if (err < 0)
+    return -1;
+
   if (!SHA1_Final(chksum, &shactx))
     return -1;
 
@@ -0,0 +1,337 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "dircache.h"
+#include "directory.h"
+
+#define DIRENT_NAME_LEN ((int) sizeof(((struct direntv6 *) 0)->d_name))
+#define DIR_BUCKETS  256
+#define PATH_BUCKETS 16384
+
+/**
+ * The name index of one directory: its live entries, in directory order, and
+ * an open addressing table of indices into them (-1 for an empty slot) that's
+ * always at most half full.
+ */
+struct dirindex {
+  int inumber;
+  int numEntries;
+  int capacity;
+  struct direntv6 *entries;
+  int *offsets;            // the byte offset of each entry within the directory
+  int firstFree;           // the byte offset of the first unused entry, or -1
+  int tableSize;           // a power of two
+  int *table;
+  struct dirindex *next;   // next index in the same bucket
+};
+
+struct pathentry {
+  char *path;              // not NUL terminated
+  int length;
+  int inumber;
+  struct pathentry *next;  // next entry in the same bucket
+};
+
+struct dircache {
+  pthread_mutex_t lock;    // guards everything below
+  struct dirindex *dirs[DIR_BUCKETS];
+  int numDirs;
+  struct pathentry *paths[PATH_BUCKETS];
+  int numPaths;
+  struct dircache_stats stats;
+};
+
+// FNV-1a
+static unsigned int HashBytes(const char *s, int length) {
+  unsigned int h = 2166136261u;
+  for (int i = 0; i < length; i++) {
+    h ^= (unsigned char) s[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+static int NameLength(const struct direntv6 *d) {
+  return strnlen(d->d_name, DIRENT_NAME_LEN);
+}
+
+static void FreeIndex(struct dirindex *di) {
+  free(di->entries);
+  free(di->offsets);
+  free(di->table);
+  free(di);
+}
+
+static void DropIndexes(struct dircache *dc) {
+  for (int b = 0; b < DIR_BUCKETS; b++) {
+    while (dc->dirs[b] != NULL) {
+      struct dirindex *di = dc->dirs[b];
+      dc->dirs[b] = di->next;
+      FreeIndex(di);
+    }
+  }
+  dc->numDirs = 0;
+}
+
+static void DropPaths(struct dircache *dc) {
+  for (int b = 0; b < PATH_BUCKETS; b++) {
+    while (dc->paths[b] != NULL) {
+      struct pathentry *pe = dc->paths[b];
+      dc->paths[b] = pe->next;
+      free(pe->path);
+      free(pe);
+    }
+  }
+  dc->numPaths = 0;
+}
+
+/**
+ * Returns the slot of the table holding the entry with the specified name, or
+ * the empty slot where it belongs if there isn't one.
+ */
+static int ProbeIndex(const struct dirindex *di, const char *name, int length) {
+  int mask = di->tableSize - 1;
+  for (int slot = HashBytes(name, length) & mask; ; slot = (slot + 1) & mask) {
+    int e = di->table[slot];
+    if (e == -1) return slot;
+    const struct direntv6 *d = &di->entries[e];
+    if (NameLength(d) == length && memcmp(d->d_name, name, length) == 0) return slot;
+  }
+}
+
+/**
+ * Reads the directory with the specified inumber, one entry at a time, and
+ * builds its name index.  Unused entries (inumber 0) are left out, and when a
+ * name appears twice the first entry wins, as it would for a linear search.
+ * Returns NULL if the inode isn't a readable directory or memory runs out.
+ */
+static struct dirindex *BuildIndex(struct unixfilesystem *fs, int dirinumber) {
+  struct direntiter it;
+  if (directory_open(fs, dirinumber, &it) < 0) return NULL;
+
+  int maxEntries = it.dir.size / sizeof(struct direntv6);
+  int tableSize = 4;
+  while (tableSize < 2 * maxEntries) tableSize *= 2;
+  int capacity = (maxEntries > 0) ? maxEntries : 1;
+  struct dirindex *di = malloc(sizeof(struct dirindex));
+  if (di != NULL) {
+    di->entries = malloc(capacity * sizeof(struct direntv6));
+    di->offsets = malloc(capacity * sizeof(int));
+    di->table = malloc(tableSize * sizeof(int));
+  }
+  if (di == NULL || di->entries == NULL || di->offsets == NULL || di->table == NULL) {
+    if (di != NULL) FreeIndex(di);
+    directory_close(&it);
+    return NULL;
+  }
+  di->inumber = dirinumber;
+  di->numEntries = 0;
+  di->capacity = capacity;
+  di->firstFree = -1;
+  di->tableSize = tableSize;
+  for (int slot = 0; slot < tableSize; slot++) di->table[slot] = -1;
+
+  struct direntv6 d;
+  int more;
+  for (int offset = 0; (more = directory_next(&it, &d)) > 0; offset += sizeof(struct direntv6)) {
+    if (d.d_inumber == 0) {
+      if (di->firstFree == -1) di->firstFree = offset;
+      continue;
+    }
+    int slot = ProbeIndex(di, d.d_name, NameLength(&d));
+    if (di->table[slot] != -1) continue;
+    di->entries[di->numEntries] = d;
+    di->offsets[di->numEntries] = offset;
+    di->table[slot] = di->numEntries++;
+  }
+  directory_close(&it);
+  if (more < 0) {
+    FreeIndex(di);
+    return NULL;
+  }
+  return di;
+}
+
+struct dircache *dircache_create(void) {
+  struct dircache *dc = calloc(1, sizeof(struct dircache));
+  if (dc == NULL) return NULL;
+  pthread_mutex_init(&dc->lock, NULL);
+  return dc;
+}
+
+void dircache_free(struct dircache *dc) {
+  if (dc == NULL) return;
+  DropIndexes(dc);
+  DropPaths(dc);
+  pthread_mutex_destroy(&dc->lock);
+  free(dc);
+}
+
+static struct dirindex *FindIndex(struct dircache *dc, int dirinumber) {
+  struct dirindex *di = dc->dirs[(unsigned int) dirinumber % DIR_BUCKETS];
+  while (di != NULL && di->inumber != dirinumber) di = di->next;
+  return di;
+}
+
+/**
+ * Makes room in an index for one more entry.  Returns 0 on success, -1 if
+ * memory ran out.
+ */
+static int GrowIndex(struct dirindex *di) {
+  if (di->numEntries == di->capacity) {
+    int capacity = 2 * di->capacity;
+    struct direntv6 *entries = realloc(di->entries, capacity * sizeof(struct direntv6));
+    if (entries == NULL) return -1;
+    di->entries = entries;
+    int *offsets = realloc(di->offsets, capacity * sizeof(int));
+    if (offsets == NULL) return -1;
+    di->offsets = offsets;
+    di->capacity = capacity;
+  }
+  if (2 * (di->numEntries + 1) > di->tableSize) {
+    int *table = malloc(2 * di->tableSize * sizeof(int));
+    if (table == NULL) return -1;
+    free(di->table);
+    di->table = table;
+    di->tableSize *= 2;
+    for (int slot = 0; slot < di->tableSize; slot++) di->table[slot] = -1;
+    for (int e = 0; e < di->numEntries; e++) {
+      di->table[ProbeIndex(di, di->entries[e].d_name, NameLength(&di->entries[e]))] = e;
+    }
+  }
+  return 0;
+}
+
+int dircache_findname(struct unixfilesystem *fs, const char *name, int dirinumber, struct direntv6 *dirEnt) {
+  return dircache_findentry(fs, name, dirinumber, dirEnt, NULL);
+}
+
+int dircache_findentry(struct unixfilesystem *fs, const char *name, int dirinumber,
+                       struct direntv6 *dirEnt, int *offset) {
+  int length = strlen(name);
+  if (length > DIRENT_NAME_LEN) return -1;
+
+  struct dircache *dc = fs->dircache;
+  pthread_mutex_lock(&dc->lock);
+  struct dirindex *di = FindIndex(dc, dirinumber);
+  if (di != NULL) {
+    dc->stats.nameHits++;
+  } else {
+    di = BuildIndex(fs, dirinumber);
+    if (di == NULL) {
+      pthread_mutex_unlock(&dc->lock);
+      return -1;
+    }
+    dc->stats.indexBuilds++;
+    if (dc->numDirs >= DIRCACHE_MAX_DIRS) DropIndexes(dc);
+    int bucket = (unsigned int) dirinumber % DIR_BUCKETS;
+    di->next = dc->dirs[bucket];
+    dc->dirs[bucket] = di;
+    dc->numDirs++;
+  }
+
+  int e = di->table[ProbeIndex(di, name, length)];
+  if (e != -1) {
+    *dirEnt = di->entries[e];
+    if (offset != NULL) *offset = di->offsets[e];
+  }
+  pthread_mutex_unlock(&dc->lock);
+  return (e != -1) ? 0 : -1;
+}
+
+int dircache_freeslot(struct unixfilesystem *fs, int dirinumber) {
+  struct dircache *dc = fs->dircache;
+  pthread_mutex_lock(&dc->lock);
+  struct dirindex *di = FindIndex(dc, dirinumber);
+  int offset = (di != NULL) ? di->firstFree : -1;
+  pthread_mutex_unlock(&dc->lock);
+  return offset;
+}
+
+void dircache_addname(struct unixfilesystem *fs, int dirinumber, const struct direntv6 *dirEnt, int offset) {
+  struct dircache *dc = fs->dircache;
+  pthread_mutex_lock(&dc->lock);
+  struct dirindex **link = &dc->dirs[(unsigned int) dirinumber % DIR_BUCKETS];
+  while (*link != NULL && (*link)->inumber != dirinumber) link = &(*link)->next;
+  struct dirindex *di = *link;
+  if (di != NULL) {
+    // Filling the first unused entry leaves no telling where the next one is,
+    // and an index that can't grow is no use, so both drop the index.
+    if (offset == di->firstFree || GrowIndex(di) < 0) {
+      *link = di->next;
+      FreeIndex(di);
+      dc->numDirs--;
+    } else {
+      int slot = ProbeIndex(di, dirEnt->d_name, NameLength(dirEnt));
+      if (di->table[slot] == -1) {
+        di->entries[di->numEntries] = *dirEnt;
+        di->offsets[di->numEntries] = offset;
+        di->table[slot] = di->numEntries++;
+      }
+    }
+  }
+  pthread_mutex_unlock(&dc->lock);
+}
+
+int dircache_lookuppath(struct unixfilesystem *fs, const char *pathname, int length) {
+  struct dircache *dc = fs->dircache;
+  pthread_mutex_lock(&dc->lock);
+  struct pathentry *pe = dc->paths[HashBytes(pathname, length) % PATH_BUCKETS];
+  while (pe != NULL && (pe->length != length || memcmp(pe->path, pathname, length) != 0)) pe = pe->next;
+  int inumber = -1;
+  if (pe != NULL) {
+    inumber = pe->inumber;
+    dc->stats.pathHits++;
+  } else {
+    dc->stats.pathMisses++;
+  }
+  pthread_mutex_unlock(&dc->lock);
+  return inumber;
+}
+
+void dircache_addpath(struct unixfilesystem *fs, const char *pathname, int length, int inumber) {
+  struct pathentry *pe = malloc(sizeof(struct pathentry));
+  char *path = malloc(length > 0 ? length : 1);
+  if (pe == NULL || path == NULL) {
+    // The cache is only an optimization, so there's nothing to report.
+    free(pe);
+    free(path);
+    return;
+  }
+  memcpy(path, pathname, length);
+  pe->path = path;
+  pe->length = length;
+  pe->inumber = inumber;
+
+  struct dircache *dc = fs->dircache;
+  pthread_mutex_lock(&dc->lock);
+  if (dc->numPaths >= DIRCACHE_MAX_PATHS) DropPaths(dc);
+  int bucket = HashBytes(pathname, length) % PATH_BUCKETS;
+  pe->next = dc->paths[bucket];
+  dc->paths[bucket] = pe;
+  dc->numPaths++;
+  pthread_mutex_unlock(&dc->lock);
+}
+
+void dircache_invalidate(struct unixfilesystem *fs, int dirinumber) {
+  struct dircache *dc = fs->dircache;
+  pthread_mutex_lock(&dc->lock);
+  struct dirindex **link = &dc->dirs[(unsigned int) dirinumber % DIR_BUCKETS];
+  while (*link != NULL && (*link)->inumber != dirinumber) link = &(*link)->next;
+  if (*link != NULL) {
+    struct dirindex *di = *link;
+    *link = di->next;
+    FreeIndex(di);
+    dc->numDirs--;
+  }
+  // Any path through the directory may now be stale.
+  DropPaths(dc);
+  pthread_mutex_unlock(&dc->lock);
+}
+
+void dircache_getstats(struct unixfilesystem *fs, struct dircache_stats *stats) {
+  pthread_mutex_lock(&fs->dircache->lock);
+  *stats = fs->dircache->stats;
+  pthread_mutex_unlock(&fs->dircache->lock);
+}
@@ -0,0 +1,94 @@
+#ifndef _DIRCACHE_H_
+#define _DIRCACHE_H_
+
+#include "unixfilesystem.h"
+#include "direntv6.h"
+
+/**
+ * The directory cache keeps two kinds of entries for each filesystem:
+ *
+ *   name indexes  a hash table per directory from each name in it to its
+ *                 directory entry, built the first time the directory is
+ *                 searched, so later searches read no sectors at all
+ *   path entries  a hash table from absolute pathnames (and all of their
+ *                 prefixes) to inumbers, so resolving a path only has to walk
+ *                 the components after its longest previously resolved prefix
+ *
+ * When either table outgrows its limit it's emptied and starts over.  Any
+ * number of threads may use the cache at once.
+ */
+#define DIRCACHE_MAX_DIRS  1024
+#define DIRCACHE_MAX_PATHS 65536
+
+struct dircache_stats {
+  long nameHits;    // directory searches answered by an existing index
+  long indexBuilds; // directories read to build an index
+  long pathHits;    // path prefixes found in the cache
+  long pathMisses;  // path prefixes that had to be resolved
+};
+
+/**
+ * Allocates an empty cache, or returns NULL if out of memory.
+ */
+struct dircache *dircache_create(void);
+
+/**
+ * Releases a cache and everything in it.
+ */
+void dircache_free(struct dircache *dc);
+
+/**
+ * Looks up the specified name in the directory with the specified inumber,
+ * building the directory's name index first if it doesn't have one.  Names
+ * match only if they're identical (up to the 14 characters a directory entry
+ * holds).  If found, the entry is copied into *dirEnt.  Returns 0 if found,
+ * -1 if the name isn't there or dirinumber isn't a readable directory.
+ */
+int dircache_findname(struct unixfilesystem *fs, const char *name, int dirinumber, struct direntv6 *dirEnt);
+
+/**
+ * Same as dircache_findname, but also sets *offset (unless offset is NULL) to
+ * the byte offset of the entry within the directory.
+ */
+int dircache_findentry(struct unixfilesystem *fs, const char *name, int dirinumber,
+                       struct direntv6 *dirEnt, int *offset);
+
+/**
+ * Returns the byte offset of the first unused entry (inumber 0) in the
+ * specified directory, or -1 if it has none or hasn't been indexed.
+ */
+int dircache_freeslot(struct unixfilesystem *fs, int dirinumber);
+
+/**
+ * Adds an entry just written at the specified byte offset of a directory to
+ * its index, if it has one, so that filling a directory one entry at a time
+ * doesn't mean reading it again after each.
+ */
+void dircache_addname(struct unixfilesystem *fs, int dirinumber, const struct direntv6 *dirEnt, int offset);
+
+/**
+ * Returns the inumber previously recorded for the specified absolute
+ * pathname, which must be in canonical form ("/" alone, or "/a/b" with no
+ * repeated or trailing slashes), or -1 if there isn't one.  length is the
+ * number of characters of pathname to consider.
+ */
+int dircache_lookuppath(struct unixfilesystem *fs, const char *pathname, int length);
+
+/**
+ * Records that the first length characters of the specified canonical
+ * pathname name the file with the specified inumber.
+ */
+void dircache_addpath(struct unixfilesystem *fs, const char *pathname, int length, int inumber);
+
+/**
+ * Forgets the name index of the specified directory along with every cached
+ * path, for use after the directory's contents change.
+ */
+void dircache_invalidate(struct unixfilesystem *fs, int dirinumber);
+
+/**
+ * Copies the counters accumulated by the specified filesystem's cache into stats.
+ */
+void dircache_getstats(struct unixfilesystem *fs, struct dircache_stats *stats);
+
+#endif // _DIRCACHE_H_
@@ -1,7 +1,5 @@
 #include "directory.h"
-#include "inode.h"
-#include "diskimg.h"
-#include "file.h"
+#include "dircache.h"
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
@@ -10,33 +8,49 @@
  * Looks up the specified name (name) in the specified directory (dirinumber).
  * If found, return the directory entry in space addressed by dirEnt.  Returns 0
  * on success and something negative on failure.
+ *
+ * The directory is read and indexed by name the first time it's searched, and
+ * every later search is answered from the index (see dircache.h).
  */
 int directory_findname(struct unixfilesystem *fs, const char *name, int dirinumber, struct direntv6 *dirEnt)
 {
-	// check if it's directory
-	struct inode ino;
-	if (inode_iget(fs, dirinumber, &ino) < 0 || (ino.i_mode & IFMT) != IFDIR)
+	return dircache_findname(fs, name, dirinumber, dirEnt);
+}
+
+int directory_open(struct unixfilesystem *fs, int dirinumber, struct direntiter *it)
+{
+	if (file_open(fs, dirinumber, &it->dir) < 0)
 		return -1;
-	// logic
-	int blockNum = 0;
-	char buf[DISKIMG_SECTOR_SIZE];
-	struct direntv6 *dir = (struct direntv6 *)buf;
-	int validSize, numEntriesInBlock;
-	while (1)
+	if ((it->dir.in.i_mode & IFMT) != IFDIR)
+	{
+		file_close(&it->dir);
+		return -1;
+	}
+	it->blockNum = 0;
+	it->entryNum = 0;
+	it->numEntries = 0;
+	it->entries = NULL;
+	return 0;
+}
+
+int directory_next(struct direntiter *it, struct direntv6 *dirEnt)
+{
+	while (it->entryNum == it->numEntries)
 	{
-		validSize = file_getblock(fs, dirinumber, blockNum, dir);
-		if (validSize <= 0)
-			break;
-		numEntriesInBlock = validSize / sizeof(struct direntv6);
-		for (int i = 0; i < numEntriesInBlock; i++)
-		{
-			if (strncmp(name, dir[i].d_name, strlen(name)) == 0)
-			{
-				*dirEnt = dir[i];
-				return 0;
-			}
-		}
-		blockNum++;
+		if (it->blockNum == it->dir.numBlocks)
+			return 0;
+		int validSize = file_readblock(&it->dir, it->blockNum, it->buf, (const void **)&it->entries);
+		if (validSize < 0)
+			return -1;
+		it->blockNum++;
+		it->entryNum = 0;
+		it->numEntries = validSize / sizeof(struct direntv6);
 	}
-	return -1;
+	*dirEnt = it->entries[it->entryNum++];
+	return 1;
+}
+
+void directory_close(struct direntiter *it)
+{
+	file_close(&it->dir);
 }
@@ -3,6 +3,8 @@
 
 #include "unixfilesystem.h"
 #include "direntv6.h"
+#include "diskimg.h"
+#include "file.h"
 
 /**
  * Looks up the specified name (name) in the specified directory (dirinumber).  
@@ -12,4 +14,37 @@
 int directory_findname(struct unixfilesystem *fs, const char *name,
                        int dirinumber, struct direntv6 *dirEnt);
 
+/**
+ * An open directory being read one entry at a time.  Only the directory
+ * block currently being read is held in memory, so a directory of any size
+ * can be read in constant space.
+ */
+struct direntiter {
+  struct openfile dir;
+  int blockNum;                   // the next block to read
+  int entryNum;                   // the next entry in the current block
+  int numEntries;                 // the number of entries in the current block
+  const struct direntv6 *entries; // the current block, in buf or in place
+  char buf[DISKIMG_SECTOR_SIZE];
+};
+
+/**
+ * Opens the directory with the specified inumber for reading.  Returns 0 on
+ * success, -1 on error (including if the inode isn't a directory).
+ */
+int directory_open(struct unixfilesystem *fs, int dirinumber, struct direntiter *it);
+
+/**
+ * Copies the next entry of an open directory into *dirEnt, unused entries
+ * (inumber 0) included.  Returns 1 if there was one, 0 at the end of the
+ * directory, -1 on error.
+ */
+int directory_next(struct direntiter *it, struct direntv6 *dirEnt);
+
+/**
+ * Releases a directory opened with directory_open.
+ */
+void directory_close(struct direntiter *it);
+
 #endif // _DIECTORY_H_
+
@@ -4,6 +4,7 @@
 #include <assert.h>
 #include <string.h>
 #include <getopt.h>
+#include <pthread.h>
 
 #include "diskimg.h"
 #include "unixfilesystem.h"
@@ -12,24 +13,49 @@
 #include "directory.h"
 #include "pathname.h"
 #include "chksumfile.h"
+#include "dircache.h"
+#include "treewalk.h"
 
 int quietFlag = 0;
 int idumpFlag = 0;
 int pdumpFlag = 0;
+int statsFlag = 0;
+int mmapFlag = 0;
+int numThreads = 1;
 
 static void PrintDirectory(struct unixfilesystem *fs, char *pathname);
 static void DumpInodeChecksum(struct unixfilesystem *fs, FILE *f);
+static void DumpInodeChecksumParallel(struct unixfilesystem *fs, FILE *f, int numThreads);
+static int DumpOneInode(struct unixfilesystem *fs, int inumber, FILE *f, FILE *errf);
 static void DumpPathnameChecksum(struct unixfilesystem *fs, FILE *f);
 static void PrintUsageAndExit(char *progname);
-static int GetDirEntries(struct unixfilesystem *fs, int inumber, struct direntv6 *entries, int maxNumEntries);
+static int DumpPath(struct unixfilesystem *fs, const struct treewalk_entry *entry, void *aux);
 
 int main(int argc, char *argv[])
 {
   int opt;
-  while ((opt = getopt(argc, argv, "iqp")) != -1)
+  while ((opt = getopt(argc, argv, "iqpc:smj:")) != -1)
   {
     switch (opt)
     {
+    case 'c':
+      if (diskimg_setcachesize(atoi(optarg)) < 0)
+      {
+        fprintf(stderr, "Can't set the sector cache size to %s\n", optarg);
+        exit(EXIT_FAILURE);
+      }
+      break;
+    case 's':
+      statsFlag = 1;
+      break;
+    case 'm':
+      mmapFlag = 1;
+      break;
+    case 'j':
+      numThreads = atoi(optarg);
+      if (numThreads < 1)
+        PrintUsageAndExit(argv[0]);
+      break;
     case 'q':
       quietFlag = 1;
       break;
@@ -58,7 +84,7 @@ int main(int argc, char *argv[])
     exit(EXIT_FAILURE);
   }
 
-  struct unixfilesystem *fs = unixfilesystem_init(fd);
+  struct unixfilesystem *fs = unixfilesystem_initbackend(fd, mmapFlag ? UNIXFILESYSTEM_MMAP : UNIXFILESYSTEM_PREAD);
   if (!fs)
   {
     fprintf(stderr, "Failed to initialize unix filesystem\n");
@@ -73,8 +99,8 @@ int main(int argc, char *argv[])
       fprintf(stderr, "Error getting the size of %s\n", argv[1]);
       // Cast the result of diskimg_close to void so the compiler doesn't
       // complain that we're ignoring its return value.
+      unixfilesystem_free(fs);
       (void)diskimg_close(fd);
-      free(fs);
       exit(EXIT_FAILURE);
     }
     printf("Disk %s is %d bytes (%d KB)\n", argv[1], disksize, disksize / 1024);
@@ -84,15 +110,29 @@ int main(int argc, char *argv[])
     printf("Superblock s_ninode %d\n", (int)fs->superblock.s_ninode);
   }
 
-  if (idumpFlag)
+  if (idumpFlag && numThreads > 1)
+    DumpInodeChecksumParallel(fs, stdout, numThreads);
+  else if (idumpFlag)
     DumpInodeChecksum(fs, stdout);
   if (pdumpFlag)
     DumpPathnameChecksum(fs, stdout);
 
+  if (statsFlag)
+  {
+    struct diskimg_cachestats stats;
+    diskimg_getcachestats(&stats);
+    fprintf(stderr, "Sector cache: %ld hits, %ld misses, %ld evictions, %ld reads (%ld sectors), %ld writes\n",
+            stats.hits, stats.misses, stats.evictions, stats.reads, stats.sectors, stats.writes);
+    struct dircache_stats dstats;
+    dircache_getstats(fs, &dstats);
+    fprintf(stderr, "Directory cache: %ld name hits, %ld index builds, %ld path hits, %ld path misses\n",
+            dstats.nameHits, dstats.indexBuilds, dstats.pathHits, dstats.pathMisses);
+  }
+
+  unixfilesystem_free(fs);
   int err = diskimg_close(fd);
   if (err < 0)
     fprintf(stderr, "Error closing %s\n", argv[1]);
-  free(fs);
   exit(EXIT_SUCCESS);
   return 0;
 }
@@ -107,108 +147,234 @@ static void DumpInodeChecksum(struct unixfilesystem *fs, FILE *f)
 {
   for (int inumber = 1; inumber < fs->superblock.s_isize * 16; inumber++)
   {
-    struct inode in;
-    if (inode_iget(fs, inumber, &in) < 0)
-    {
-      fprintf(stderr, "Can't read inode %d \n", inumber);
+    if (DumpOneInode(fs, inumber, f, stderr) < 0)
       return;
-    }
-    if ((in.i_mode & IALLOC) == 0)
+  }
+}
+
+/**
+ * Output the checksum line for one inode to f, or an error to errf.  Returns
+ * -1 if the inode couldn't be read at all, in which case the dump should stop.
+ */
+static int DumpOneInode(struct unixfilesystem *fs, int inumber, FILE *f, FILE *errf)
+{
+  struct inode in;
+  if (inode_iget(fs, inumber, &in) < 0)
+  {
+    fprintf(errf, "Can't read inode %d \n", inumber);
+    return -1;
+  }
+  if ((in.i_mode & IALLOC) == 0)
+  {
+    // Skip this inode if it's not allocated.
+    return 0;
+  }
+
+  char chksum[CHKSUMFILE_SIZE];
+  if (chksumfile_byinumber(fs, inumber, chksum) < 0)
+  {
+    fprintf(errf, "Inode %d can't compute chksum\n", inumber);
+    return 0;
+  }
+
+  char chksumstring[CHKSUMFILE_STRINGSIZE];
+  chksumfile_cvt2string(chksum, chksumstring);
+
+  int size = inode_getsize(&in);
+  fprintf(f, "Inode %d mode 0x%x size %d checksum %s\n", inumber, in.i_mode, size, chksumstring);
+  return 0;
+}
+
+/**
+ * The parallel inode dump splits the inodes into chunks of INODES_PER_CHUNK.
+ * Worker threads claim chunks in order and format each chunk's output (and
+ * error messages) into memory, and the calling thread writes the chunks out
+ * in inumber order as they're finished, so the output is exactly what the
+ * serial dump produces.  Workers never run more than CHUNK_WINDOW chunks
+ * ahead of the output, which bounds the memory held by finished chunks.
+ */
+#define INODES_PER_CHUNK 64
+#define CHUNK_WINDOW 256
+
+struct inodechunk {
+  char *out;
+  size_t outLen;
+  char *err;
+  size_t errLen;
+  int done;
+  int stop;  // an inode in this chunk couldn't be read
+};
+
+struct inodedump {
+  struct unixfilesystem *fs;
+  int numInodes;
+  int numChunks;
+  struct inodechunk *chunks;
+  int nextChunk;   // the next chunk to be claimed
+  int written;     // the number of chunks written out so far
+  int stopping;
+  pthread_mutex_t lock;
+  pthread_cond_t chunkDone;
+  pthread_cond_t windowOpen;
+};
+
+static void *DumpInodeWorker(void *arg)
+{
+  struct inodedump *dump = arg;
+  while (1)
+  {
+    pthread_mutex_lock(&dump->lock);
+    while (!dump->stopping && dump->nextChunk < dump->numChunks &&
+           dump->nextChunk >= dump->written + CHUNK_WINDOW)
+      pthread_cond_wait(&dump->windowOpen, &dump->lock);
+    if (dump->stopping || dump->nextChunk >= dump->numChunks)
     {
-      // Skip this inode if it's not allocated.
-      continue;
+      pthread_mutex_unlock(&dump->lock);
+      return NULL;
     }
-
-    char chksum[CHKSUMFILE_SIZE];
-    if (chksumfile_byinumber(fs, inumber, chksum) < 0)
+    int c = dump->nextChunk++;
+    pthread_mutex_unlock(&dump->lock);
+
+    struct inodechunk *chunk = &dump->chunks[c];
+    FILE *out = open_memstream(&chunk->out, &chunk->outLen);
+    FILE *err = open_memstream(&chunk->err, &chunk->errLen);
+    int last = (c + 1) * INODES_PER_CHUNK;
+    if (last > dump->numInodes)
+      last = dump->numInodes;
+    for (int inumber = c * INODES_PER_CHUNK + 1; inumber <= last; inumber++)
     {
-      fprintf(stderr, "Inode %d can't compute chksum\n", inumber);
-      continue;
+      if (DumpOneInode(dump->fs, inumber, out, err) < 0)
+      {
+        chunk->stop = 1;
+        break;
+      }
     }
+    fclose(out);
+    fclose(err);
+
+    pthread_mutex_lock(&dump->lock);
+    chunk->done = 1;
+    pthread_cond_broadcast(&dump->chunkDone);
+    pthread_mutex_unlock(&dump->lock);
+  }
+}
 
-    char chksumstring[CHKSUMFILE_STRINGSIZE];
-    chksumfile_cvt2string(chksum, chksumstring);
+/**
+ * Same output as DumpInodeChecksum, computed by numThreads worker threads.
+ */
+static void DumpInodeChecksumParallel(struct unixfilesystem *fs, FILE *f, int numThreads)
+{
+  struct inodedump dump;
+  dump.fs = fs;
+  dump.numInodes = fs->superblock.s_isize * 16 - 1;
+  dump.numChunks = (dump.numInodes + INODES_PER_CHUNK - 1) / INODES_PER_CHUNK;
+  dump.chunks = calloc(dump.numChunks > 0 ? dump.numChunks : 1, sizeof(struct inodechunk));
+  if (dump.chunks == NULL)
+  {
+    fprintf(stderr, "Out of memory.\n");
+    return;
+  }
+  dump.nextChunk = dump.written = dump.stopping = 0;
+  pthread_mutex_init(&dump.lock, NULL);
+  pthread_cond_init(&dump.chunkDone, NULL);
+  pthread_cond_init(&dump.windowOpen, NULL);
+
+  pthread_t workers[numThreads];
+  int numWorkers = 0;
+  while (numWorkers < numThreads &&
+         pthread_create(&workers[numWorkers], NULL, DumpInodeWorker, &dump) == 0)
+    numWorkers++;
+  if (numWorkers == 0)
+    DumpInodeWorker(&dump);
+
+  for (int c = 0; c < dump.numChunks; c++)
+  {
+    pthread_mutex_lock(&dump.lock);
+    while (!dump.chunks[c].done)
+      pthread_cond_wait(&dump.chunkDone, &dump.lock);
+    pthread_mutex_unlock(&dump.lock);
+
+    struct inodechunk *chunk = &dump.chunks[c];
+    fwrite(chunk->out, 1, chunk->outLen, f);
+    fflush(f);
+    fwrite(chunk->err, 1, chunk->errLen, stderr);
+    free(chunk->out);
+    free(chunk->err);
+
+    pthread_mutex_lock(&dump.lock);
+    dump.written = c + 1;
+    if (chunk->stop)
+      dump.stopping = 1;
+    pthread_cond_broadcast(&dump.windowOpen);
+    pthread_mutex_unlock(&dump.lock);
+    if (chunk->stop)
+      break;
+  }
 
-    int size = inode_getsize(&in);
-    fprintf(f, "Inode %d mode 0x%x size %d checksum %s\n", inumber, in.i_mode, size, chksumstring);
+  for (int i = 0; i < numWorkers; i++)
+    pthread_join(workers[i], NULL);
+  // chunks finished after a stop were never written out
+  for (int c = dump.written; c < dump.numChunks; c++)
+  {
+    free(dump.chunks[c].out);
+    free(dump.chunks[c].err);
   }
+  free(dump.chunks);
+  pthread_mutex_destroy(&dump.lock);
+  pthread_cond_destroy(&dump.chunkDone);
+  pthread_cond_destroy(&dump.windowOpen);
 }
 
 /**
- * Output to the specified file the checksum of the specified pathname and
- * inode as well as all its children if it is a directory.
+ * Output to the specified file (aux) the checksum of the specified pathname
+ * and inode.  The tree walk then carries on into its children if it's a
+ * directory.  The inumber the walk found the file under is checked against
+ * the one its pathname resolves to, and only if they differ are the two
+ * files' checksums compared.
  *
  * This is used by the grading script, so be careful not to change its output
  * format.
  */
-static void DumpPathAndChildren(struct unixfilesystem *fs, const char *pathname, int inumber, FILE *f)
+static int DumpPath(struct unixfilesystem *fs, const struct treewalk_entry *entry, void *aux)
 {
-  struct inode in;
-  if (inode_iget(fs, inumber, &in) < 0)
+  FILE *f = aux;
+  const char *pathname = entry->pathname;
+  int inumber = entry->inumber;
+  if (entry->in == NULL)
   {
     fprintf(stderr, "Can't read inode %d \n", inumber);
-    return;
+    return TREEWALK_PRUNE;
   }
-  assert(in.i_mode & IALLOC);
+  assert(entry->in->i_mode & IALLOC);
 
   char chksum1[CHKSUMFILE_SIZE];
   if (chksumfile_byinumber(fs, inumber, chksum1) < 0)
   {
     fprintf(stderr, "Can't checksum inode %d path %s\n", inumber, pathname);
-    return;
+    return TREEWALK_PRUNE;
   }
 
+  int pathinumber = pathname_lookup(fs, pathname);
   char chksum2[CHKSUMFILE_SIZE];
-  if (chksumfile_bypathname(fs, pathname, chksum2) < 0)
+  if (pathinumber < 0 ||
+      (pathinumber != inumber && chksumfile_byinumber(fs, pathinumber, chksum2) < 0))
   {
     fprintf(stderr, "Can't checksum inode %d path %s\n", inumber, pathname);
-    return;
+    return TREEWALK_PRUNE;
   }
 
-  if (!chksumfile_compare(chksum1, chksum2))
+  if (pathinumber != inumber && !chksumfile_compare(chksum1, chksum2))
   {
     fprintf(stderr, "Pathname checksum of %s differs from inode %d\n", pathname, inumber);
-    return;
+    return TREEWALK_PRUNE;
   }
 
   char chksumstring[CHKSUMFILE_STRINGSIZE];
-  chksumfile_cvt2string(chksum2, chksumstring);
+  chksumfile_cvt2string(chksum1, chksumstring);
+  struct inode in = *entry->in;
   int size = inode_getsize(&in);
   fprintf(f, "Path %s %d mode 0x%x size %d checksum %s\n", pathname, inumber, in.i_mode, size, chksumstring);
-
-  if (pathname[1] == 0)
-  {
-    /* pathame == "/" */
-    pathname++; /* Delete extra / character */
-  }
-
-  if ((in.i_mode & IFMT) == IFDIR)
-  {
-    const unsigned int MAXPATH = 1024;
-    if (strlen(pathname) > MAXPATH - 16)
-    {
-      fprintf(stderr, "Too deep of directories %s\n", pathname);
-    }
-
-    struct direntv6 direntries[10000];
-    int numentries = GetDirEntries(fs, inumber, direntries, 10000);
-    for (int i = 0; i < numentries; i++)
-    {
-      char *n = direntries[i].d_name;
-      if (n[0] == '.')
-      {
-        if ((n[1] == 0) || ((n[1] == '.') && (n[2] == 0)))
-        {
-          /* Skip over "." and ".." */
-          continue;
-        }
-      }
-
-      char nextpath[MAXPATH];
-      sprintf(nextpath, "%s/%s", pathname, direntries[i].d_name);
-      DumpPathAndChildren(fs, nextpath, direntries[i].d_inumber, f);
-    }
-  }
+  return TREEWALK_CONTINUE;
 }
 
 /**
@@ -218,11 +384,15 @@ static void DumpPathAndChildren(struct unixfilesystem *fs, const char *pathname,
  */
 static void DumpPathnameChecksum(struct unixfilesystem *fs, FILE *f)
 {
-  DumpPathAndChildren(fs, "/", ROOT_INUMBER, f);
+  if (treewalk(fs, "/", ROOT_INUMBER, DumpPath, f) < 0)
+  {
+    fprintf(stderr, "Out of memory.\n");
+  }
 }
 
 /**
- * Print all the entries in the specified directory.
+ * Print all the entries in the specified directory, reading it one entry at
+ * a time.
  */
 static void PrintDirectory(struct unixfilesystem *fs, char *pathname)
 {
@@ -233,66 +403,24 @@ static void PrintDirectory(struct unixfilesystem *fs, char *pathname)
     return;
   }
 
-  struct direntv6 direntries[10000];
-  int numentries = GetDirEntries(fs, inumber, direntries, 10000);
-  if (numentries < 0)
+  struct direntiter it;
+  if (directory_open(fs, inumber, &it) < 0)
   {
     fprintf(stderr, "Can't read entries from %s\n", pathname);
     return;
   }
 
-  for (int i = 0; i < numentries; i++)
-  {
-    printf("Direntry %s Name %s Inumber %d\n", pathname, direntries[i].d_name, direntries[i].d_inumber);
-  }
-}
-
-/**
- * Fetch as many entries from a directory that will fit in the specified array. Return the
- * number of entries found.
- */
-static int GetDirEntries(struct unixfilesystem *fs, int inumber, struct direntv6 *entries, int maxNumEntries)
-{
-  struct inode in;
-  int err = inode_iget(fs, inumber, &in);
-  if (err < 0)
-    return err;
-
-  if (!(in.i_mode & IALLOC) || ((in.i_mode & IFMT) != IFDIR))
+  struct direntv6 d;
+  int more;
+  while ((more = directory_next(&it, &d)) > 0)
   {
-    /* Not allocated or not a directory */
-    return -1;
+    printf("Direntry %s Name %.14s Inumber %d\n", pathname, d.d_name, d.d_inumber);
   }
-
-  if (maxNumEntries < 1)
-    return -1;
-  int size = inode_getsize(&in);
-
-  assert((size % sizeof(struct direntv6)) == 0);
-
-  int count = 0;
-  int numBlocks = (size + DISKIMG_SECTOR_SIZE - 1) / DISKIMG_SECTOR_SIZE;
-  char buf[DISKIMG_SECTOR_SIZE];
-  struct direntv6 *dir = (struct direntv6 *)buf;
-  for (int bno = 0; bno < numBlocks; bno++)
+  if (more < 0)
   {
-    int bytesLeft, numEntriesInBlock, i;
-    bytesLeft = file_getblock(fs, inumber, bno, dir);
-    if (bytesLeft < 0)
-    {
-      fprintf(stderr, "Error reading directory\n");
-      return -1;
-    }
-    numEntriesInBlock = bytesLeft / sizeof(struct direntv6);
-    for (i = 0; i < numEntriesInBlock; i++)
-    {
-      entries[count] = dir[i];
-      count++;
-      if (count >= maxNumEntries)
-        return count;
-    }
+    fprintf(stderr, "Error reading directory\n");
   }
-  return count;
+  directory_close(&it);
 }
 
 static void PrintUsageAndExit(char *progname)
@@ -302,5 +430,9 @@ static void PrintUsageAndExit(char *progname)
   fprintf(stderr, "-q     don't print extra info\n");
   fprintf(stderr, "-i     print all inode checksums\n");
   fprintf(stderr, "-p     print all pathname checksums\n");
+  fprintf(stderr, "-c N   cache up to N sectors (0 turns the sector cache off)\n");
+  fprintf(stderr, "-s     print sector and directory cache statistics to stderr when done\n");
+  fprintf(stderr, "-m     read the image through a memory mapping instead of pread\n");
+  fprintf(stderr, "-j N   compute the inode checksums (-i) with N threads\n");
   exit(EXIT_FAILURE);
 }
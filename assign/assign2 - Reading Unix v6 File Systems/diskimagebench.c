@@ -0,0 +1,260 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "diskimg.h"
+#include "unixfilesystem.h"
+#include "inode.h"
+#include "pathname.h"
+#include "chksumfile.h"
+#include "treewalk.h"
+
+/**
+ * Measures how fast disk images can be read, for use on images made by
+ * diskimagepopulate (which can be as large as v6 allows) rather than the
+ * small test disks.  For each image two workloads are run through the
+ * library:
+ *   inodes   checksum every allocated inode (the work diskimageaccess -i does)
+ *   paths    walk the tree, resolving and checksumming every path (the work
+ *            diskimageaccess -p does)
+ * with each of these ways of reading it:
+ *   pread        diskimg_readsector with the sector cache turned off
+ *   pread+cache  diskimg_readsector with the default sector cache
+ *   mmap         sectors read in place from a mapping of the whole image
+ * The best of ROUNDS runs is reported for each, along with the number of
+ * read system calls and sectors the run read.  Then diskimageaccess itself
+ * is run with -i and with -p, and its wall time and the counts it reports
+ * with -s are shown the same way.
+ */
+
+#define ROUNDS 3
+
+struct backend {
+  const char *name;
+  int kind;
+  int cacheSectors;
+};
+
+static const struct backend backends[] = {
+  {"pread", UNIXFILESYSTEM_PREAD, 0},
+  {"pread+cache", UNIXFILESYSTEM_PREAD, DISKIMG_DEFAULT_CACHE_SECTORS},
+  {"mmap", UNIXFILESYSTEM_MMAP, 0},
+};
+
+struct workload {
+  const char *name;
+  long (*run)(struct unixfilesystem *fs);
+  const char *accessFlag;  // the diskimageaccess option doing the same work
+};
+
+static double Now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Checksums every allocated inode, returning the number of bytes hashed,
+ * or -1 if anything couldn't be read.
+ */
+static long ChecksumAllInodes(struct unixfilesystem *fs)
+{
+  long bytes = 0;
+  for (int inumber = 1; inumber < fs->superblock.s_isize * 16; inumber++)
+  {
+    struct inode in;
+    if (inode_iget(fs, inumber, &in) < 0)
+      return -1;
+    if ((in.i_mode & IALLOC) == 0)
+      continue;
+    char chksum[CHKSUMFILE_SIZE];
+    if (chksumfile_byinumber(fs, inumber, chksum) < 0)
+      return -1;
+    bytes += inode_getsize(&in);
+  }
+  return bytes;
+}
+
+static int ChecksumPath(struct unixfilesystem *fs, const struct treewalk_entry *entry, void *aux)
+{
+  long *bytes = aux;
+  char chksum[CHKSUMFILE_SIZE];
+  if (entry->in == NULL || pathname_lookup(fs, entry->pathname) != entry->inumber ||
+      chksumfile_byinumber(fs, entry->inumber, chksum) < 0)
+  {
+    *bytes = -1;
+    return -1;
+  }
+  struct inode in = *entry->in;
+  *bytes += inode_getsize(&in);
+  return TREEWALK_CONTINUE;
+}
+
+/**
+ * Resolves and checksums every path, returning the number of bytes hashed,
+ * or -1 if anything couldn't be read.
+ */
+static long ChecksumAllPaths(struct unixfilesystem *fs)
+{
+  long bytes = 0;
+  if (treewalk(fs, "/", ROOT_INUMBER, ChecksumPath, &bytes) < 0)
+    return -1;
+  return bytes;
+}
+
+static const struct workload workloads[] = {
+  {"inodes", ChecksumAllInodes, "-i"},
+  {"paths", ChecksumAllPaths, "-p"},
+};
+
+static int BenchLibrary(char *diskpath, const struct workload *w)
+{
+  for (size_t b = 0; b < sizeof(backends) / sizeof(backends[0]); b++)
+  {
+    double best = 0;
+    long bytes = 0, reads = 0, sectors = 0;
+    for (int round = 0; round < ROUNDS; round++)
+    {
+      diskimg_setcachesize(backends[b].cacheSectors);
+      int fd = diskimg_open(diskpath, 1);
+      if (fd < 0)
+      {
+        fprintf(stderr, "Can't open diskimagePath %s\n", diskpath);
+        return -1;
+      }
+      struct unixfilesystem *fs = unixfilesystem_initbackend(fd, backends[b].kind);
+      if (fs == NULL)
+      {
+        diskimg_close(fd);
+        return -1;
+      }
+      struct diskimg_cachestats before, after;
+      diskimg_getcachestats(&before);
+      double start = Now();
+      bytes = w->run(fs);
+      double elapsed = Now() - start;
+      diskimg_getcachestats(&after);
+      unixfilesystem_free(fs);
+      diskimg_close(fd);
+      if (bytes < 0)
+      {
+        fprintf(stderr, "Error reading %s\n", diskpath);
+        return -1;
+      }
+      if (round == 0 || elapsed < best)
+        best = elapsed;
+      reads = after.reads - before.reads;
+      sectors = after.sectors - before.sectors;
+    }
+    printf("  %-8s %-12s %10.1f %10.1f %10ld %10ld\n", w->name, backends[b].name,
+           best * 1000, bytes / best / (1 << 20), reads, sectors);
+  }
+  return 0;
+}
+
+/**
+ * Runs diskimageaccess with the specified option (and -q -s) on the image,
+ * reporting its wall time and the read counts it prints.  Returns 0 on
+ * success, -1 if it couldn't be run.
+ */
+static int BenchProgram(const char *accessPath, char *diskpath, const struct workload *w)
+{
+  // diskimageaccess's stderr comes down the pipe and its stdout is thrown away
+  char *command = malloc(strlen(accessPath) + strlen(diskpath) + 64);
+  if (command == NULL)
+    return -1;
+  sprintf(command, "'%s' -qs %s '%s' 2>&1 >/dev/null", accessPath, w->accessFlag, diskpath);
+
+  double best = 0;
+  long reads = -1, sectors = -1;
+  for (int round = 0; round < ROUNDS; round++)
+  {
+    double start = Now();
+    FILE *f = popen(command, "r");
+    if (f == NULL)
+    {
+      free(command);
+      return -1;
+    }
+    char line[256];
+    long hits, misses, evictions;
+    while (fgets(line, sizeof(line), f) != NULL)
+      sscanf(line, "Sector cache: %ld hits, %ld misses, %ld evictions, %ld reads (%ld sectors)",
+             &hits, &misses, &evictions, &reads, &sectors);
+    int status = pclose(f);
+    double elapsed = Now() - start;
+    if (status != 0)
+    {
+      fprintf(stderr, "%s failed\n", command);
+      free(command);
+      return -1;
+    }
+    if (round == 0 || elapsed < best)
+      best = elapsed;
+  }
+  printf("  %-8s %-12s %10.1f %10s %10ld %10ld\n", w->name, w->accessFlag, best * 1000, "",
+         reads, sectors);
+  free(command);
+  return 0;
+}
+
+static int BenchImage(char *diskpath, const char *accessPath)
+{
+  printf("%s\n", diskpath);
+  printf("  %-8s %-12s %10s %10s %10s %10s\n", "workload", "backend", "ms", "MB/s", "reads", "sectors");
+  for (size_t w = 0; w < sizeof(workloads) / sizeof(workloads[0]); w++)
+  {
+    if (BenchLibrary(diskpath, &workloads[w]) < 0)
+      return -1;
+  }
+  if (accessPath == NULL)
+    return 0;
+  for (size_t w = 0; w < sizeof(workloads) / sizeof(workloads[0]); w++)
+  {
+    if (BenchProgram(accessPath, diskpath, &workloads[w]) < 0)
+      return -1;
+  }
+  return 0;
+}
+
+int main(int argc, char *argv[])
+{
+  const char *accessPath = "./diskimageaccess";
+  int opt;
+  while ((opt = getopt(argc, argv, "a:n")) != -1)
+  {
+    switch (opt)
+    {
+    case 'a':
+      accessPath = optarg;
+      break;
+    case 'n':
+      accessPath = NULL;
+      break;
+    default:
+      optind = argc;
+    }
+  }
+  if (optind >= argc)
+  {
+    fprintf(stderr, "Usage: %s [-a diskimageaccessPath | -n] diskimagePath...\n", argv[0]);
+    fprintf(stderr, "-a P   run the diskimageaccess at P (default ./diskimageaccess)\n");
+    fprintf(stderr, "-n     only benchmark the library, not diskimageaccess\n");
+    exit(EXIT_FAILURE);
+  }
+  if (accessPath != NULL && access(accessPath, X_OK) < 0)
+  {
+    fprintf(stderr, "Can't run %s\n", accessPath);
+    exit(EXIT_FAILURE);
+  }
+  for (int i = optind; i < argc; i++)
+  {
+    if (BenchImage(argv[i], accessPath) < 0)
+      exit(EXIT_FAILURE);
+  }
+  return 0;
+}
@@ -0,0 +1,449 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "diskimg.h"
+#include "unixfilesystem.h"
+#include "inode.h"
+#include "pathname.h"
+#include "chksumfile.h"
+#include "treewalk.h"
+
+/**
+ * Reports how one disk image of a filesystem differs from another (an older
+ * snapshot of it, typically) without reading the files that didn't change:
+ *
+ *   1. Both inode tables are read in bulk and compared inode by inode.  An
+ *      inode is unchanged if everything but its access time is identical
+ *      and, for large files, so is its block map.  Unix v6 sets a file's
+ *      modify time whenever its contents are written, which is what makes
+ *      this enough.
+ *   2. Both directory trees are walked, recording the paths of changed
+ *      inodes and every entry of a changed directory.  Wherever the same
+ *      path names different directories in the two images, both subtrees
+ *      are recorded in full.
+ *   3. The recorded paths are merged.  A path found in only one image was
+ *      added or removed.  A path found in both is only checksummed, on both
+ *      sides, if its inode changed but its type and size didn't.
+ *
+ * Every changed path is printed, in order, as "A path" (added), "D path"
+ * (removed) or "M path" (modified).  Directories added or removed along with
+ * everything under them are printed once, with a trailing slash.  The exit
+ * status is 0 if the images hold the same files, 1 if they don't, and 2 on
+ * error, as for diff.
+ */
+
+struct pathrec {
+  char *path;
+  int inumber;
+};
+
+struct image {
+  char *diskpath;
+  int fd;
+  struct unixfilesystem *fs;
+  int numInodes;
+  struct inode *inodes;  // inodes[i - 1] is inode i
+  struct pathrec *paths;
+  int numPaths;
+  int pathCapacity;
+};
+
+struct walkcontext {
+  struct image *img;
+  const unsigned char *changed;  // indexed by inumber
+  int recordAll;
+};
+
+static int statsFlag = 0;
+static long filesHashed = 0;
+
+static void PrintUsageAndExit(char *progname)
+{
+  fprintf(stderr, "Usage: %s [-m] [-s] olddiskimagePath newdiskimagePath\n", progname);
+  fprintf(stderr, "-m     read the images through memory mappings instead of pread\n");
+  fprintf(stderr, "-s     print what was compared and read to stderr when done\n");
+  exit(2);
+}
+
+/**
+ * Opens the specified image and reads its whole inode table.  Returns 0 on
+ * success, -1 on error.
+ */
+static int OpenImage(struct image *img, char *diskpath, int backend)
+{
+  memset(img, 0, sizeof(struct image));
+  img->diskpath = diskpath;
+  img->fd = diskimg_open(diskpath, 1);
+  if (img->fd < 0)
+  {
+    fprintf(stderr, "Can't open diskimagePath %s\n", diskpath);
+    return -1;
+  }
+  img->fs = unixfilesystem_initbackend(img->fd, backend);
+  if (img->fs == NULL)
+  {
+    fprintf(stderr, "Failed to initialize unix filesystem on %s\n", diskpath);
+    return -1;
+  }
+  int numSectors = img->fs->superblock.s_isize;
+  img->numInodes = numSectors * DISKIMG_SECTOR_SIZE / sizeof(struct inode);
+  img->inodes = malloc(numSectors > 0 ? numSectors * DISKIMG_SECTOR_SIZE : 1);
+  if (img->inodes == NULL ||
+      unixfilesystem_getsectors(img->fs, INODE_START_SECTOR, numSectors, img->inodes) < 0)
+  {
+    fprintf(stderr, "Can't read the inodes of %s\n", diskpath);
+    return -1;
+  }
+  return 0;
+}
+
+static void CloseImage(struct image *img)
+{
+  for (int i = 0; i < img->numPaths; i++)
+    free(img->paths[i].path);
+  free(img->paths);
+  free(img->inodes);
+  unixfilesystem_free(img->fs);
+  if (img->fd >= 0)
+    diskimg_close(img->fd);
+}
+
+/**
+ * Returns the specified inode if it's allocated, NULL otherwise.
+ */
+static struct inode *AllocatedInode(struct image *img, int inumber)
+{
+  if (inumber < 1 || inumber > img->numInodes)
+    return NULL;
+  struct inode *in = &img->inodes[inumber - 1];
+  return (in->i_mode & IALLOC) ? in : NULL;
+}
+
+/**
+ * Compares two inodes as step 1 describes.  Returns 1 if they're the same,
+ * 0 if they differ, -1 if a block map couldn't be read.
+ */
+static int SameInode(struct image *a, struct image *b, int inumber)
+{
+  struct inode *ina = AllocatedInode(a, inumber);
+  struct inode *inb = AllocatedInode(b, inumber);
+  if (ina == NULL || inb == NULL)
+    return ina == inb;
+
+  struct inode x = *ina, y = *inb;
+  x.i_atime[0] = x.i_atime[1] = y.i_atime[0] = y.i_atime[1] = 0;
+  if (memcmp(&x, &y, sizeof(struct inode)) != 0)
+    return 0;
+  if ((x.i_mode & ILARG) == 0)
+    return 1;
+
+  // identical addresses of indirect blocks, but their contents may differ
+  int numBlocks = (inode_getsize(&x) + DISKIMG_SECTOR_SIZE - 1) / DISKIMG_SECTOR_SIZE;
+  uint16_t *mapa = malloc((numBlocks + 1) * sizeof(uint16_t));
+  uint16_t *mapb = malloc((numBlocks + 1) * sizeof(uint16_t));
+  int same = -1;
+  if (mapa != NULL && mapb != NULL &&
+      inode_blockmap(a->fs, &x, mapa, numBlocks) == 0 &&
+      inode_blockmap(b->fs, &y, mapb, numBlocks) == 0)
+    same = memcmp(mapa, mapb, numBlocks * sizeof(uint16_t)) == 0;
+  free(mapa);
+  free(mapb);
+  return same;
+}
+
+static int AddPath(struct image *img, const char *pathname, int inumber)
+{
+  if (img->numPaths == img->pathCapacity)
+  {
+    int capacity = img->pathCapacity ? 2 * img->pathCapacity : 256;
+    struct pathrec *paths = realloc(img->paths, capacity * sizeof(struct pathrec));
+    if (paths == NULL)
+      return -1;
+    img->paths = paths;
+    img->pathCapacity = capacity;
+  }
+  char *path = strdup(pathname);
+  if (path == NULL)
+    return -1;
+  img->paths[img->numPaths].path = path;
+  img->paths[img->numPaths].inumber = inumber;
+  img->numPaths++;
+  return 0;
+}
+
+/**
+ * Tree walk visitor that records the paths step 2 describes.
+ */
+static int RecordPath(struct unixfilesystem *fs, const struct treewalk_entry *entry, void *aux)
+{
+  struct walkcontext *ctx = aux;
+  if (entry->in == NULL)
+    return TREEWALK_PRUNE;
+  if (ctx->recordAll || ctx->changed[entry->inumber] || ctx->changed[entry->parentInumber])
+  {
+    if (AddPath(ctx->img, entry->pathname, entry->inumber) < 0)
+      return -1;
+  }
+  return TREEWALK_CONTINUE;
+}
+
+static int WalkImage(struct image *img, const char *pathname, int inumber,
+                     const unsigned char *changed, int recordAll)
+{
+  struct walkcontext ctx = {img, changed, recordAll};
+  return treewalk(img->fs, pathname, inumber, RecordPath, &ctx);
+}
+
+/**
+ * Orders pathnames so that everything below a directory comes right after
+ * it, by treating '/' as smaller than any other character.
+ */
+static int PathCompare(const char *a, const char *b)
+{
+  while (*a != '\0' && *a == *b)
+  {
+    a++;
+    b++;
+  }
+  int ca = (*a == '/') ? 1 : (unsigned char)*a;
+  int cb = (*b == '/') ? 1 : (unsigned char)*b;
+  return ca - cb;
+}
+
+static int ComparePathRecs(const void *a, const void *b)
+{
+  return PathCompare(((const struct pathrec *)a)->path, ((const struct pathrec *)b)->path);
+}
+
+static void SortPaths(struct image *img)
+{
+  qsort(img->paths, img->numPaths, sizeof(struct pathrec), ComparePathRecs);
+  int kept = 0;
+  for (int i = 0; i < img->numPaths; i++)
+  {
+    if (kept > 0 && strcmp(img->paths[kept - 1].path, img->paths[i].path) == 0)
+      free(img->paths[i].path);
+    else
+      img->paths[kept++] = img->paths[i];
+  }
+  img->numPaths = kept;
+}
+
+/**
+ * Returns the index of the first path after paths[i] that isn't below it.
+ */
+static int SkipSubtree(const struct image *img, int i)
+{
+  const char *dir = img->paths[i].path;
+  int length = strlen(dir);
+  for (i++; i < img->numPaths; i++)
+  {
+    const char *path = img->paths[i].path;
+    if (strncmp(path, dir, length) != 0 || path[length] != '/')
+      break;
+  }
+  return i;
+}
+
+static int IsDirectory(struct image *img, int inumber)
+{
+  struct inode *in = AllocatedInode(img, inumber);
+  return in != NULL && (in->i_mode & IFMT) == IFDIR;
+}
+
+/**
+ * Decides whether the file a path names in the old image (ia) differs from
+ * the one it names in the new image (ib), checksumming both only if nothing
+ * cheaper settles it.  A directory is never modified itself; the changes
+ * to its entries are reported as the paths below it.
+ */
+static int Differs(struct image *a, int ia, struct image *b, int ib, const unsigned char *changed)
+{
+  if (ia == ib && !changed[ia])
+    return 0;
+  struct inode *ina = AllocatedInode(a, ia);
+  struct inode *inb = AllocatedInode(b, ib);
+  if (ina == NULL || inb == NULL)
+    return 1;
+  if ((ina->i_mode & ~ILARG) != (inb->i_mode & ~ILARG))
+    return 1;
+  if ((ina->i_mode & IFMT) == IFDIR)
+    return 0;
+  if (inode_getsize(ina) != inode_getsize(inb))
+    return 1;
+
+  char chksuma[CHKSUMFILE_SIZE], chksumb[CHKSUMFILE_SIZE];
+  filesHashed += 2;
+  if (chksumfile_byinumber(a->fs, ia, chksuma) < 0 || chksumfile_byinumber(b->fs, ib, chksumb) < 0)
+    return 1;
+  return !chksumfile_compare(chksuma, chksumb);
+}
+
+static void Report(char kind, const char *pathname, int isDirectory)
+{
+  printf("%c %s%s\n", kind, pathname, isDirectory ? "/" : "");
+}
+
+/**
+ * Merges the sorted paths recorded from both images, printing every
+ * difference.  A path recorded from just one image is looked up in the
+ * other before being called added or removed.  Returns the number of
+ * differences.
+ */
+static long MergePaths(struct image *a, struct image *b, const unsigned char *changed)
+{
+  long differences = 0;
+  int i = 0, j = 0;
+  while (i < a->numPaths || j < b->numPaths)
+  {
+    int order;
+    if (i == a->numPaths)
+      order = 1;
+    else if (j == b->numPaths)
+      order = -1;
+    else
+      order = PathCompare(a->paths[i].path, b->paths[j].path);
+
+    if (order == 0)
+    {
+      if (Differs(a, a->paths[i].inumber, b, b->paths[j].inumber, changed))
+      {
+        Report('M', b->paths[j].path, 0);
+        differences++;
+      }
+      i++;
+      j++;
+    }
+    else if (order < 0)
+    {
+      int ib = pathname_lookup(b->fs, a->paths[i].path);
+      if (ib < 0)
+      {
+        int isDir = IsDirectory(a, a->paths[i].inumber);
+        Report('D', a->paths[i].path, isDir);
+        differences++;
+        i = isDir ? SkipSubtree(a, i) : i + 1;
+        continue;
+      }
+      if (Differs(a, a->paths[i].inumber, b, ib, changed))
+      {
+        Report('M', a->paths[i].path, 0);
+        differences++;
+      }
+      i++;
+    }
+    else
+    {
+      int ia = pathname_lookup(a->fs, b->paths[j].path);
+      if (ia < 0)
+      {
+        int isDir = IsDirectory(b, b->paths[j].inumber);
+        Report('A', b->paths[j].path, isDir);
+        differences++;
+        j = isDir ? SkipSubtree(b, j) : j + 1;
+        continue;
+      }
+      if (Differs(a, ia, b, b->paths[j].inumber, changed))
+      {
+        Report('M', b->paths[j].path, 0);
+        differences++;
+      }
+      j++;
+    }
+  }
+  return differences;
+}
+
+int main(int argc, char *argv[])
+{
+  int backend = UNIXFILESYSTEM_PREAD;
+  int opt;
+  while ((opt = getopt(argc, argv, "ms")) != -1)
+  {
+    switch (opt)
+    {
+    case 'm':
+      backend = UNIXFILESYSTEM_MMAP;
+      break;
+    case 's':
+      statsFlag = 1;
+      break;
+    default:
+      PrintUsageAndExit(argv[0]);
+    }
+  }
+  if (optind != argc - 2)
+    PrintUsageAndExit(argv[0]);
+
+  struct image a, b;
+  if (OpenImage(&a, argv[optind], backend) < 0 || OpenImage(&b, argv[optind + 1], backend) < 0)
+    exit(2);
+
+  // step 1
+  int numInodes = (a.numInodes > b.numInodes) ? a.numInodes : b.numInodes;
+  unsigned char *changed = calloc(numInodes + 1, 1);
+  if (changed == NULL)
+  {
+    fprintf(stderr, "Out of memory.\n");
+    exit(2);
+  }
+  int numChanged = 0;
+  for (int inumber = 1; inumber <= numInodes; inumber++)
+  {
+    int same = SameInode(&a, &b, inumber);
+    if (same < 0)
+    {
+      fprintf(stderr, "Can't read the block map of inode %d\n", inumber);
+      exit(2);
+    }
+    changed[inumber] = !same;
+    numChanged += !same;
+  }
+
+  // step 2, which has nothing to find if no inode changed
+  if (numChanged > 0 &&
+      (WalkImage(&a, "/", ROOT_INUMBER, changed, 0) < 0 || WalkImage(&b, "/", ROOT_INUMBER, changed, 0) < 0))
+  {
+    fprintf(stderr, "Out of memory.\n");
+    exit(2);
+  }
+  int numRecorded = b.numPaths;
+  for (int p = 0; p < numRecorded; p++)
+  {
+    int ib = b.paths[p].inumber;
+    if (!IsDirectory(&b, ib))
+      continue;
+    int ia = pathname_lookup(a.fs, b.paths[p].path);
+    if (ia < 0 || ia == ib || !IsDirectory(&a, ia))
+      continue;
+    // The same path names different directories, so nothing can be assumed
+    // about their subtrees.  Copy the path first; AddPath may move it.
+    char *path = strdup(b.paths[p].path);
+    if (path == NULL || WalkImage(&a, path, ia, changed, 1) < 0 || WalkImage(&b, path, ib, changed, 1) < 0)
+    {
+      fprintf(stderr, "Out of memory.\n");
+      exit(2);
+    }
+    free(path);
+  }
+  SortPaths(&a);
+  SortPaths(&b);
+
+  // step 3
+  long differences = MergePaths(&a, &b, changed);
+
+  if (statsFlag)
+  {
+    struct diskimg_cachestats stats;
+    diskimg_getcachestats(&stats);
+    fprintf(stderr, "%d of %d inodes changed, %d + %d paths compared, %ld files checksummed, %ld sector reads\n",
+            numChanged, numInodes, a.numPaths, b.numPaths, filesHashed, stats.reads);
+  }
+
+  free(changed);
+  CloseImage(&a);
+  CloseImage(&b);
+  return differences > 0 ? 1 : 0;
+}
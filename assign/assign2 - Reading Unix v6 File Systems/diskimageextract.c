@@ -0,0 +1,406 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "diskimg.h"
+#include "unixfilesystem.h"
+#include "inode.h"
+#include "file.h"
+#include "pathname.h"
+#include "treewalk.h"
+
+/**
+ * Copies the files of a disk image (or of one directory in it) out into a
+ * directory on the host, keeping their permission bits.
+ *
+ * The calling thread walks the tree, making each directory as it comes to it
+ * and queueing each regular file.  A pool of worker threads takes files off
+ * the queue, reads each one EXTRACT_RUN_BLOCKS blocks at a time with
+ * file_readblocks, and writes them out with pwrite.  Directory permissions
+ * are only applied at the very end, so that a read-only directory can still
+ * be filled.  Device files are skipped.
+ *
+ * With -b the files are instead copied by the calling thread one block at a
+ * time, with file_getblock and stdio, for comparison.
+ */
+
+#define EXTRACT_RUN_BLOCKS 128
+#define QUEUE_SIZE 1024
+
+struct extractjob {
+  char *hostpath;
+  int inumber;
+  int mode;
+};
+
+struct extractor {
+  struct unixfilesystem *fs;
+  const char *outdir;
+  int rootLength;  // how much of each walked pathname the output directory stands for
+  int baseline;
+
+  // directories made so far, so their modes can be applied at the end
+  struct extractjob *dirs;
+  int numDirs;
+  int dirCapacity;
+
+  // the queue of files for the workers
+  struct extractjob queue[QUEUE_SIZE];
+  int head;
+  int count;
+  int done;  // nothing more will be queued
+  pthread_mutex_t lock;
+  pthread_cond_t notEmpty;
+  pthread_cond_t notFull;
+
+  // totals, guarded by lock
+  long files;
+  long bytes;
+  long errors;
+};
+
+// what each worker thread is handed: the shared state and its own run buffer
+struct extractworker {
+  struct extractor *ex;
+  char *buf;
+};
+
+static double Now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void PrintUsageAndExit(char *progname)
+{
+  fprintf(stderr, "Usage: %s [-j N] [-m] [-b] diskimagePath outputDirectory [pathname]\n", progname);
+  fprintf(stderr, "-j N   copy files out with N worker threads (default 4)\n");
+  fprintf(stderr, "-m     read the image through a memory mapping instead of pread\n");
+  fprintf(stderr, "-b     copy one block at a time through stdio on one thread instead\n");
+  fprintf(stderr, "pathname is the directory in the image to extract (default /)\n");
+  exit(EXIT_FAILURE);
+}
+
+/**
+ * Copies a file out block by block, the way extraction used to be done.
+ * Returns the number of bytes copied, or -1 on error.
+ */
+static long CopyByBlock(struct unixfilesystem *fs, int inumber, const char *hostpath, int mode)
+{
+  struct inode in;
+  if (inode_iget(fs, inumber, &in) < 0)
+    return -1;
+  FILE *f = fopen(hostpath, "w");
+  if (f == NULL)
+    return -1;
+  int size = inode_getsize(&in);
+  int numBlocks = (size + DISKIMG_SECTOR_SIZE - 1) / DISKIMG_SECTOR_SIZE;
+  long copied = 0;
+  char buf[DISKIMG_SECTOR_SIZE];
+  for (int bno = 0; bno < numBlocks; bno++)
+  {
+    int validBytes = file_getblock(fs, inumber, bno, buf);
+    if (validBytes < 0 || (int)fwrite(buf, 1, validBytes, f) != validBytes)
+    {
+      copied = -1;
+      break;
+    }
+    copied += validBytes;
+  }
+  if (fclose(f) != 0 || chmod(hostpath, mode) < 0)
+    copied = -1;
+  return copied;
+}
+
+/**
+ * Copies a file out in runs of EXTRACT_RUN_BLOCKS blocks, each written with
+ * one pwrite.  Returns the number of bytes copied, or -1 on error.
+ */
+static long CopyByRun(struct unixfilesystem *fs, int inumber, const char *hostpath, int mode, char *buf)
+{
+  struct openfile file;
+  if (file_open(fs, inumber, &file) < 0)
+    return -1;
+  int fd = open(hostpath, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  if (fd < 0)
+  {
+    file_close(&file);
+    return -1;
+  }
+  long copied = 0;
+  for (int bno = 0; bno < file.numBlocks; bno += EXTRACT_RUN_BLOCKS)
+  {
+    int numBlocks = file.numBlocks - bno;
+    if (numBlocks > EXTRACT_RUN_BLOCKS)
+      numBlocks = EXTRACT_RUN_BLOCKS;
+    int validBytes = file_readblocks(&file, bno, numBlocks, buf);
+    if (validBytes < 0 || pwrite(fd, buf, validBytes, (off_t)bno * DISKIMG_SECTOR_SIZE) != validBytes)
+    {
+      copied = -1;
+      break;
+    }
+    copied += validBytes;
+  }
+  file_close(&file);
+  // fchmod rather than open's mode, which the umask would have trimmed
+  if (fchmod(fd, mode) < 0 || close(fd) < 0)
+    copied = -1;
+  return copied;
+}
+
+static void CountError(struct extractor *ex)
+{
+  pthread_mutex_lock(&ex->lock);
+  ex->errors++;
+  pthread_mutex_unlock(&ex->lock);
+}
+
+static void Tally(struct extractor *ex, const char *hostpath, long copied)
+{
+  pthread_mutex_lock(&ex->lock);
+  if (copied < 0)
+  {
+    fprintf(stderr, "Can't extract %s\n", hostpath);
+    ex->errors++;
+  }
+  else
+  {
+    ex->files++;
+    ex->bytes += copied;
+  }
+  pthread_mutex_unlock(&ex->lock);
+}
+
+static void *ExtractWorker(void *arg)
+{
+  struct extractworker *worker = arg;
+  struct extractor *ex = worker->ex;
+  while (1)
+  {
+    pthread_mutex_lock(&ex->lock);
+    while (ex->count == 0 && !ex->done)
+      pthread_cond_wait(&ex->notEmpty, &ex->lock);
+    if (ex->count == 0)
+    {
+      pthread_mutex_unlock(&ex->lock);
+      break;
+    }
+    struct extractjob job = ex->queue[ex->head];
+    ex->head = (ex->head + 1) % QUEUE_SIZE;
+    ex->count--;
+    pthread_cond_signal(&ex->notFull);
+    pthread_mutex_unlock(&ex->lock);
+
+    Tally(ex, job.hostpath, CopyByRun(ex->fs, job.inumber, job.hostpath, job.mode, worker->buf));
+    free(job.hostpath);
+  }
+  return NULL;
+}
+
+static void Enqueue(struct extractor *ex, struct extractjob job)
+{
+  pthread_mutex_lock(&ex->lock);
+  while (ex->count == QUEUE_SIZE)
+    pthread_cond_wait(&ex->notFull, &ex->lock);
+  ex->queue[(ex->head + ex->count) % QUEUE_SIZE] = job;
+  ex->count++;
+  pthread_cond_signal(&ex->notEmpty);
+  pthread_mutex_unlock(&ex->lock);
+}
+
+/**
+ * Tree walk visitor: makes directories, and copies out or queues regular
+ * files.
+ */
+static int ExtractEntry(struct unixfilesystem *fs, const struct treewalk_entry *entry, void *aux)
+{
+  struct extractor *ex = aux;
+  if (entry->in == NULL)
+  {
+    fprintf(stderr, "Can't read inode %d for %s\n", entry->inumber, entry->pathname);
+    CountError(ex);
+    return TREEWALK_PRUNE;
+  }
+  int type = entry->in->i_mode & IFMT;
+  if (type == IFCHR || type == IFBLK)
+  {
+    fprintf(stderr, "Skipping device file %s\n", entry->pathname);
+    return TREEWALK_PRUNE;
+  }
+
+  // the walk's pathnames start with "/", so they can just be appended
+  char *hostpath = malloc(strlen(ex->outdir) + strlen(entry->pathname) + 1);
+  if (hostpath == NULL)
+    return -1;
+  sprintf(hostpath, "%s%s", ex->outdir, entry->depth == 0 ? "" : entry->pathname + ex->rootLength);
+  struct extractjob job = {hostpath, entry->inumber, entry->in->i_mode & 07777};
+
+  if (type == IFDIR)
+  {
+    if (mkdir(hostpath, 0700) < 0 && errno != EEXIST)
+    {
+      fprintf(stderr, "Can't make directory %s\n", hostpath);
+      free(hostpath);
+      CountError(ex);
+      return TREEWALK_PRUNE;
+    }
+    if (ex->numDirs == ex->dirCapacity)
+    {
+      int capacity = ex->dirCapacity ? 2 * ex->dirCapacity : 64;
+      struct extractjob *dirs = realloc(ex->dirs, capacity * sizeof(struct extractjob));
+      if (dirs == NULL)
+      {
+        free(hostpath);
+        return -1;
+      }
+      ex->dirs = dirs;
+      ex->dirCapacity = capacity;
+    }
+    ex->dirs[ex->numDirs++] = job;
+    return TREEWALK_CONTINUE;
+  }
+
+  if (ex->baseline)
+  {
+    Tally(ex, hostpath, CopyByBlock(fs, entry->inumber, hostpath, job.mode));
+    free(hostpath);
+  }
+  else
+  {
+    Enqueue(ex, job);
+  }
+  return TREEWALK_CONTINUE;
+}
+
+int main(int argc, char *argv[])
+{
+  int numThreads = 4, mmapFlag = 0, baseline = 0;
+  int opt;
+  while ((opt = getopt(argc, argv, "j:mb")) != -1)
+  {
+    switch (opt)
+    {
+    case 'j':
+      numThreads = atoi(optarg);
+      if (numThreads < 1)
+        PrintUsageAndExit(argv[0]);
+      break;
+    case 'm':
+      mmapFlag = 1;
+      break;
+    case 'b':
+      baseline = 1;
+      break;
+    default:
+      PrintUsageAndExit(argv[0]);
+    }
+  }
+  if (optind != argc - 2 && optind != argc - 3)
+    PrintUsageAndExit(argv[0]);
+  char *diskpath = argv[optind];
+  const char *pathname = (optind == argc - 3) ? argv[optind + 2] : "/";
+
+  int fd = diskimg_open(diskpath, 1);
+  if (fd < 0)
+  {
+    fprintf(stderr, "Can't open diskimagePath %s\n", diskpath);
+    exit(EXIT_FAILURE);
+  }
+  struct unixfilesystem *fs = unixfilesystem_initbackend(fd, mmapFlag ? UNIXFILESYSTEM_MMAP : UNIXFILESYSTEM_PREAD);
+  if (fs == NULL)
+  {
+    fprintf(stderr, "Failed to initialize unix filesystem\n");
+    exit(EXIT_FAILURE);
+  }
+  int inumber = pathname_lookup(fs, pathname);
+  if (inumber < 0)
+  {
+    fprintf(stderr, "Can't find %s\n", pathname);
+    exit(EXIT_FAILURE);
+  }
+
+  struct extractor ex;
+  memset(&ex, 0, sizeof(ex));
+  ex.fs = fs;
+  ex.outdir = argv[optind + 1];
+  // the walk names the children of "/" "/name", and those of "/a" "/a/name"
+  ex.rootLength = strcmp(pathname, "/") == 0 ? 0 : strlen(pathname);
+  ex.baseline = baseline;
+  pthread_mutex_init(&ex.lock, NULL);
+  pthread_cond_init(&ex.notEmpty, NULL);
+  pthread_cond_init(&ex.notFull, NULL);
+
+  // every worker's buffer is allocated up front, since a worker that couldn't
+  // get one would leave the walk blocked on a full queue
+  char *buffers = NULL;
+  if (!baseline)
+  {
+    buffers = malloc((size_t)numThreads * EXTRACT_RUN_BLOCKS * DISKIMG_SECTOR_SIZE);
+    if (buffers == NULL)
+    {
+      fprintf(stderr, "Out of memory.\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  double start = Now();
+  pthread_t workers[numThreads];
+  struct extractworker args[numThreads];
+  int numWorkers = 0;
+  while (!baseline && numWorkers < numThreads)
+  {
+    args[numWorkers].ex = &ex;
+    args[numWorkers].buf = buffers + (size_t)numWorkers * EXTRACT_RUN_BLOCKS * DISKIMG_SECTOR_SIZE;
+    if (pthread_create(&workers[numWorkers], NULL, ExtractWorker, &args[numWorkers]) != 0)
+      break;
+    numWorkers++;
+  }
+  if (!baseline && numWorkers == 0)
+  {
+    fprintf(stderr, "Can't start any worker threads\n");
+    exit(EXIT_FAILURE);
+  }
+
+  int err = treewalk(fs, pathname, inumber, ExtractEntry, &ex);
+  pthread_mutex_lock(&ex.lock);
+  ex.done = 1;
+  pthread_cond_broadcast(&ex.notEmpty);
+  pthread_mutex_unlock(&ex.lock);
+  for (int i = 0; i < numWorkers; i++)
+    pthread_join(workers[i], NULL);
+  free(buffers);
+  if (err < 0)
+  {
+    fprintf(stderr, "Out of memory.\n");
+    ex.errors++;
+  }
+
+  // deepest directories first, so no directory is closed off before its children
+  for (int d = ex.numDirs - 1; d >= 0; d--)
+  {
+    if (chmod(ex.dirs[d].hostpath, ex.dirs[d].mode) < 0)
+    {
+      fprintf(stderr, "Can't set the mode of %s\n", ex.dirs[d].hostpath);
+      ex.errors++;
+    }
+    free(ex.dirs[d].hostpath);
+  }
+  free(ex.dirs);
+  double elapsed = Now() - start;
+
+  printf("%ld files in %d directories, %.1f MB in %.0f ms, %.1f MB/s (%s)\n",
+         ex.files, ex.numDirs, ex.bytes / 1e6, elapsed * 1000, ex.bytes / 1e6 / elapsed,
+         baseline ? "block at a time, 1 thread" : "batched pwrite");
+
+  unixfilesystem_free(fs);
+  diskimg_close(fd);
+  return ex.errors > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
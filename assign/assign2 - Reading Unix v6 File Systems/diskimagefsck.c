@@ -0,0 +1,467 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <getopt.h>
+#include <time.h>
+
+#include "diskimg.h"
+#include "unixfilesystem.h"
+#include "direntv6.h"
+
+/**
+ * Checks a disk image for the inconsistencies a crash or a bug in the write
+ * path could leave behind, in the style of the v6 icheck and dcheck:
+ *
+ *   1. The inode area is read once, front to back, INODE_CHUNK sectors at a
+ *      time.  Every block each allocated inode uses, indirect blocks
+ *      included, is set in a bitmap of the blocks in use; a block that's
+ *      already set is doubly allocated, and one outside the data area is bad.
+ *      Each indirect block is read exactly once.  Every entry of every
+ *      directory is counted against the inode it names.
+ *   2. The free list is followed from the superblock, block by block, and
+ *      set in a second bitmap.  A block both in use and free, or free twice,
+ *      is reported, as is any data block that's in neither bitmap.
+ *   3. Each allocated inode's i_nlink is compared with the number of
+ *      directory entries naming it, and the superblock's cache of free
+ *      inodes is checked to hold only free inodes.
+ *
+ * Each problem found is printed on its own line, followed by a summary and
+ * how fast the image was scanned.  The exit status is 0 if the image is
+ * consistent, 1 if it isn't, and 2 if it couldn't be checked at all.
+ */
+
+#define INODE_CHUNK 64
+#define NICFREE 100
+#define NICINOD 100
+#define ADDRS_PER_BLOCK (DISKIMG_SECTOR_SIZE / sizeof(uint16_t))
+#define DIND 7
+// the most blocks a large file can have: 7 singly and 1 doubly indirect block's worth
+#define MAX_FILE_BLOCKS (DIND * ADDRS_PER_BLOCK + ADDRS_PER_BLOCK * ADDRS_PER_BLOCK)
+
+/**
+ * The layout of a block that continues the free list (see alloc.c).
+ */
+struct freeblock {
+  uint16_t nfree;
+  uint16_t free[NICFREE];
+};
+
+struct checker {
+  struct unixfilesystem *fs;
+  int fsize;
+  int dataStart;         // the first block after the inode area
+  int numInodes;
+  uint8_t *inUse;        // bitmap of blocks some inode uses
+  uint8_t *free;         // bitmap of blocks on the free list
+  uint8_t *allocated;    // bitmap of allocated inodes, by inumber
+  uint8_t *nlink;        // each allocated inode's i_nlink, by inumber
+  int *refs;             // directory entries naming each inode, by inumber
+  uint16_t *blocks;      // the block map of the inode being checked
+
+  long problems;
+  long blocksInUse;
+  long blocksFree;
+  long indirectReads;
+  long directoryReads;
+};
+
+static double Now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void PrintUsageAndExit(char *progname)
+{
+  fprintf(stderr, "Usage: %s [-m] diskimagePath\n", progname);
+  fprintf(stderr, "-m     read the image through a memory mapping instead of pread\n");
+  exit(2);
+}
+
+static int TestBit(const uint8_t *bitmap, int n)
+{
+  return (bitmap[n / 8] >> (n % 8)) & 1;
+}
+
+static void SetBit(uint8_t *bitmap, int n)
+{
+  bitmap[n / 8] |= 1 << (n % 8);
+}
+
+static void Problem(struct checker *ck, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+static void Problem(struct checker *ck, const char *format, ...)
+{
+  va_list args;
+  va_start(args, format);
+  vprintf(format, args);
+  va_end(args);
+  putchar('\n');
+  ck->problems++;
+}
+
+/**
+ * Records that the specified inode uses the specified block.  Returns 1 if
+ * the block is in the data area (and so can be read), 0 if it isn't.
+ */
+static int Claim(struct checker *ck, int inumber, int blockNum)
+{
+  if (blockNum < ck->dataStart || blockNum >= ck->fsize)
+  {
+    Problem(ck, "inode %d: bad block %d", inumber, blockNum);
+    return 0;
+  }
+  if (TestBit(ck->inUse, blockNum))
+    Problem(ck, "inode %d: block %d is also used by another inode", inumber, blockNum);
+  else
+  {
+    SetBit(ck->inUse, blockNum);
+    ck->blocksInUse++;
+  }
+  return 1;
+}
+
+/**
+ * Claims the indirect block blockNum and copies the block numbers it lists
+ * into blocks.  Returns 0 on success, -1 if it couldn't be read.
+ */
+static int ReadIndirect(struct checker *ck, int inumber, int blockNum, uint16_t *blocks)
+{
+  memset(blocks, 0, ADDRS_PER_BLOCK * sizeof(uint16_t));
+  if (blockNum == 0 || !Claim(ck, inumber, blockNum))
+    return 0;
+  uint16_t buf[ADDRS_PER_BLOCK];
+  const uint16_t *addrs = unixfilesystem_getsector(ck->fs, blockNum, buf);
+  if (addrs == NULL)
+    return -1;
+  ck->indirectReads++;
+  memcpy(blocks, addrs, ADDRS_PER_BLOCK * sizeof(uint16_t));
+  return 0;
+}
+
+/**
+ * Claims every block of the specified inode, filling in ck->blocks with its
+ * block map (0 for holes and bad blocks).  Returns the number of entries in
+ * the map, or -1 if an indirect block couldn't be read.
+ */
+static int ClaimBlocks(struct checker *ck, int inumber, const struct inode *in)
+{
+  int numBlocks = DIND + 1;
+  if ((in->i_mode & ILARG) == 0)
+    memcpy(ck->blocks, in->i_addr, sizeof(in->i_addr));
+  else
+  {
+    // the map only runs as far as the last indirect block, to keep small files cheap
+    numBlocks = 0;
+    for (int i = 0; i < DIND; i++)
+    {
+      if (ReadIndirect(ck, inumber, in->i_addr[i], ck->blocks + i * ADDRS_PER_BLOCK) < 0)
+        return -1;
+      if (in->i_addr[i] != 0)
+        numBlocks = (i + 1) * ADDRS_PER_BLOCK;
+    }
+    uint16_t singles[ADDRS_PER_BLOCK];
+    if (ReadIndirect(ck, inumber, in->i_addr[DIND], singles) < 0)
+      return -1;
+    int numSingles = ADDRS_PER_BLOCK;
+    while (numSingles > 0 && singles[numSingles - 1] == 0)
+      numSingles--;
+    for (int i = 0; i < numSingles; i++)
+    {
+      if (ReadIndirect(ck, inumber, singles[i], ck->blocks + (DIND + i) * ADDRS_PER_BLOCK) < 0)
+        return -1;
+    }
+    if (numSingles > 0)
+      numBlocks = (DIND + numSingles) * ADDRS_PER_BLOCK;
+  }
+
+  for (int bno = 0; bno < numBlocks; bno++)
+  {
+    if (ck->blocks[bno] != 0 && !Claim(ck, inumber, ck->blocks[bno]))
+      ck->blocks[bno] = 0;
+  }
+  return numBlocks;
+}
+
+/**
+ * Counts each entry of the specified directory against the inode it names.
+ * Returns 0 on success, -1 if a block couldn't be read.
+ */
+static int CountEntries(struct checker *ck, int inumber, const struct inode *in, int numBlocks)
+{
+  int size = (in->i_size0 << 16) + in->i_size1;
+  if (size % sizeof(struct direntv6) != 0)
+    Problem(ck, "directory %d: size %d isn't a whole number of entries", inumber, size);
+  int numEntries = size / sizeof(struct direntv6);
+  const int entriesPerBlock = DISKIMG_SECTOR_SIZE / sizeof(struct direntv6);
+  for (int bno = 0; bno * entriesPerBlock < numEntries; bno++)
+  {
+    if (bno >= numBlocks || ck->blocks[bno] == 0)
+    {
+      Problem(ck, "directory %d: block %d is missing", inumber, bno);
+      continue;
+    }
+    char buf[DISKIMG_SECTOR_SIZE];
+    const struct direntv6 *entries = unixfilesystem_getsector(ck->fs, ck->blocks[bno], buf);
+    if (entries == NULL)
+      return -1;
+    ck->directoryReads++;
+    for (int e = 0; e < entriesPerBlock && bno * entriesPerBlock + e < numEntries; e++)
+    {
+      int target = entries[e].d_inumber;
+      if (target == 0)
+        continue;
+      if (target > ck->numInodes)
+        Problem(ck, "directory %d: entry %.14s names inode %d, past the last inode",
+                inumber, entries[e].d_name, target);
+      else
+        ck->refs[target]++;
+    }
+  }
+  return 0;
+}
+
+/**
+ * Step 1: a single pass over the inode area.  Returns 0 on success, -1 on
+ * error.
+ */
+static int ScanInodes(struct checker *ck)
+{
+  const int inodesPerSector = DISKIMG_SECTOR_SIZE / sizeof(struct inode);
+  struct inode *chunk = malloc(INODE_CHUNK * DISKIMG_SECTOR_SIZE);
+  if (chunk == NULL)
+    return -1;
+  int isize = ck->fs->superblock.s_isize;
+  for (int first = 0; first < isize; first += INODE_CHUNK)
+  {
+    int numSectors = isize - first < INODE_CHUNK ? isize - first : INODE_CHUNK;
+    if (unixfilesystem_getsectors(ck->fs, INODE_START_SECTOR + first, numSectors, chunk) < 0)
+    {
+      free(chunk);
+      return -1;
+    }
+    for (int i = 0; i < numSectors * inodesPerSector; i++)
+    {
+      const struct inode *in = &chunk[i];
+      int inumber = first * inodesPerSector + i + 1;
+      if ((in->i_mode & IALLOC) == 0)
+        continue;
+      SetBit(ck->allocated, inumber);
+      ck->nlink[inumber] = in->i_nlink;
+      int type = in->i_mode & IFMT;
+      if (type == IFCHR || type == IFBLK)
+        continue;  // i_addr holds a device number, not blocks
+      int numBlocks = ClaimBlocks(ck, inumber, in);
+      if (numBlocks < 0 || (type == IFDIR && CountEntries(ck, inumber, in, numBlocks) < 0))
+      {
+        free(chunk);
+        return -1;
+      }
+    }
+  }
+  free(chunk);
+  return 0;
+}
+
+/**
+ * Step 2: follows the free list, in the order alloc_block would hand the
+ * blocks out.  Returns 0 on success, -1 if a block of the list couldn't be
+ * read.
+ */
+static int ScanFreeList(struct checker *ck)
+{
+  struct freeblock list;
+  list.nfree = ck->fs->superblock.s_nfree;
+  memcpy(list.free, ck->fs->superblock.s_free, sizeof(list.free));
+  while (1)
+  {
+    if (list.nfree > NICFREE)
+    {
+      Problem(ck, "free list: a block of it claims %d entries", list.nfree);
+      return 0;
+    }
+    for (int i = list.nfree - 1; i >= 0; i--)
+    {
+      int blockNum = list.free[i];
+      if (blockNum == 0)
+        return 0;  // the end of the list
+      if (blockNum < ck->dataStart || blockNum >= ck->fsize)
+      {
+        Problem(ck, "free list: bad block %d", blockNum);
+        return 0;
+      }
+      if (TestBit(ck->free, blockNum))
+      {
+        // following the list any further would go round in circles
+        Problem(ck, "free list: block %d is on it twice", blockNum);
+        return 0;
+      }
+      SetBit(ck->free, blockNum);
+      ck->blocksFree++;
+      if (TestBit(ck->inUse, blockNum))
+        Problem(ck, "free list: block %d is also in use", blockNum);
+      if (i == 0)
+      {
+        // blockNum holds the next part of the list
+        char buf[DISKIMG_SECTOR_SIZE];
+        const struct freeblock *next = unixfilesystem_getsector(ck->fs, blockNum, buf);
+        if (next == NULL)
+          return -1;
+        list = *next;
+        break;
+      }
+    }
+    if (list.nfree == 0)
+      return 0;
+  }
+}
+
+/**
+ * Reports each run of data blocks that's neither in use nor free.
+ */
+static void FindMissingBlocks(struct checker *ck)
+{
+  for (int blockNum = ck->dataStart; blockNum < ck->fsize; blockNum++)
+  {
+    if (TestBit(ck->inUse, blockNum) || TestBit(ck->free, blockNum))
+      continue;
+    int last = blockNum;
+    while (last + 1 < ck->fsize && !TestBit(ck->inUse, last + 1) && !TestBit(ck->free, last + 1))
+      last++;
+    if (last == blockNum)
+      Problem(ck, "block %d is neither in use nor free", blockNum);
+    else
+      Problem(ck, "blocks %d-%d are neither in use nor free", blockNum, last);
+    blockNum = last;
+  }
+}
+
+/**
+ * Step 3: link counts and the superblock's free inodes.
+ */
+static void CheckInodes(struct checker *ck)
+{
+  for (int inumber = 1; inumber <= ck->numInodes; inumber++)
+  {
+    int refs = ck->refs[inumber];
+    if (!TestBit(ck->allocated, inumber))
+    {
+      if (refs > 0)
+        Problem(ck, "inode %d is free but %d directory entries name it", inumber, refs);
+    }
+    else if (refs == 0)
+      Problem(ck, "inode %d is allocated but no directory entry names it", inumber);
+    else if (refs != ck->nlink[inumber])
+      Problem(ck, "inode %d has %d links but %d directory entries name it",
+              inumber, ck->nlink[inumber], refs);
+  }
+
+  const struct filsys *sp = &ck->fs->superblock;
+  if (sp->s_ninode > NICINOD)
+  {
+    Problem(ck, "superblock: %d free inodes cached, more than %d", sp->s_ninode, NICINOD);
+    return;
+  }
+  for (int i = 0; i < sp->s_ninode; i++)
+  {
+    int inumber = sp->s_inode[i];
+    if (inumber < 1 || inumber > ck->numInodes)
+      Problem(ck, "superblock: free inode %d doesn't exist", inumber);
+    else if (TestBit(ck->allocated, inumber))
+      Problem(ck, "superblock: free inode %d is allocated", inumber);
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  int mmapFlag = 0;
+  int opt;
+  while ((opt = getopt(argc, argv, "m")) != -1)
+  {
+    switch (opt)
+    {
+    case 'm':
+      mmapFlag = 1;
+      break;
+    default:
+      PrintUsageAndExit(argv[0]);
+    }
+  }
+  if (optind != argc - 1)
+    PrintUsageAndExit(argv[0]);
+
+  char *diskpath = argv[optind];
+  int fd = diskimg_open(diskpath, 1);
+  if (fd < 0)
+  {
+    fprintf(stderr, "Can't open diskimagePath %s\n", diskpath);
+    exit(2);
+  }
+  struct unixfilesystem *fs = unixfilesystem_initbackend(fd, mmapFlag ? UNIXFILESYSTEM_MMAP : UNIXFILESYSTEM_PREAD);
+  if (fs == NULL)
+  {
+    fprintf(stderr, "Failed to initialize unix filesystem\n");
+    exit(2);
+  }
+
+  struct checker ck;
+  memset(&ck, 0, sizeof(ck));
+  ck.fs = fs;
+  ck.fsize = fs->superblock.s_fsize;
+  ck.dataStart = INODE_START_SECTOR + fs->superblock.s_isize;
+  ck.numInodes = fs->superblock.s_isize * (DISKIMG_SECTOR_SIZE / sizeof(struct inode));
+  if (ck.dataStart > ck.fsize || ck.fsize > diskimg_getsize(fd) / DISKIMG_SECTOR_SIZE)
+  {
+    fprintf(stderr, "Superblock sizes don't fit the image: s_isize %d, s_fsize %d\n",
+            fs->superblock.s_isize, ck.fsize);
+    exit(2);
+  }
+  ck.inUse = calloc(ck.fsize / 8 + 1, 1);
+  ck.free = calloc(ck.fsize / 8 + 1, 1);
+  ck.allocated = calloc(ck.numInodes / 8 + 1, 1);
+  ck.nlink = calloc(ck.numInodes + 1, 1);
+  ck.refs = calloc(ck.numInodes + 1, sizeof(int));
+  ck.blocks = malloc(MAX_FILE_BLOCKS * sizeof(uint16_t));
+  if (ck.inUse == NULL || ck.free == NULL || ck.allocated == NULL || ck.nlink == NULL ||
+      ck.refs == NULL || ck.blocks == NULL)
+  {
+    fprintf(stderr, "Out of memory.\n");
+    exit(2);
+  }
+
+  double start = Now();
+  if (ScanInodes(&ck) < 0 || ScanFreeList(&ck) < 0)
+  {
+    fprintf(stderr, "Can't read %s\n", diskpath);
+    exit(2);
+  }
+  FindMissingBlocks(&ck);
+  CheckInodes(&ck);
+  double elapsed = Now() - start;
+
+  int numAllocated = 0;
+  for (int inumber = 1; inumber <= ck.numInodes; inumber++)
+    numAllocated += TestBit(ck.allocated, inumber);
+  struct diskimg_cachestats stats;
+  diskimg_getcachestats(&stats);
+  long sectorsScanned = fs->superblock.s_isize + ck.indirectReads + ck.directoryReads;
+  printf("%s: %d of %d inodes allocated, %ld blocks in use, %ld free, %d total\n", diskpath,
+         numAllocated, ck.numInodes, ck.blocksInUse, ck.blocksFree, ck.fsize - ck.dataStart);
+  printf("%ld problem%s\n", ck.problems, ck.problems == 1 ? "" : "s");
+  printf("%ld indirect and %ld directory blocks read, %.1f MB in %.0f ms, %.1f MB/s, %.0f inodes/s, %ld reads\n",
+         ck.indirectReads, ck.directoryReads, sectorsScanned * DISKIMG_SECTOR_SIZE / 1e6,
+         elapsed * 1000, sectorsScanned * DISKIMG_SECTOR_SIZE / 1e6 / elapsed,
+         ck.numInodes / elapsed, stats.reads);
+
+  free(ck.inUse);
+  free(ck.free);
+  free(ck.allocated);
+  free(ck.nlink);
+  free(ck.refs);
+  free(ck.blocks);
+  unixfilesystem_free(fs);
+  diskimg_close(fd);
+  return ck.problems > 0 ? 1 : 0;
+}
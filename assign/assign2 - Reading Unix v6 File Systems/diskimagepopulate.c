@@ -0,0 +1,202 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+
+#include "diskimg.h"
+#include "unixfilesystem.h"
+#include "fswrite.h"
+
+/**
+ * Benchmarks the write path by formatting a disk image of the largest size
+ * v6 allows and populating it with a directory tree (fanout directories in
+ * each directory, depth levels deep) and numFiles files spread round robin
+ * across every directory, each holding between 0 and maxSize bytes, plus
+ * numLarge files of MAX_FILE_SIZE bytes, the most an inode can describe, which
+ * take the doubly indirect block.  The number of files created per second,
+ * the MB/s written and the number of write system calls issued are reported.
+ * The images it makes are also what diskimagebench is meant to be run on.
+ *
+ * With -u, every change is written back as soon as it's made, instead of
+ * inodes and the superblock being batched until the end, to show what the
+ * batching saves.
+ */
+
+#define FS_BLOCKS 65535
+#define MAX_ISIZE 4095
+#define MAX_FILE_SIZE 0xffffff  // i_size0 and i_size1 hold 24 bits
+
+static double Now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void PrintUsageAndExit(char *progname)
+{
+  fprintf(stderr, "Usage: %s [-n files] [-s maxsize] [-L files] [-f fanout] [-l depth] [-r seed] [-u] diskimagePath\n", progname);
+  fprintf(stderr, "-n N   create N files (default 20000)\n");
+  fprintf(stderr, "-s N   make each file up to N bytes long (default 2048)\n");
+  fprintf(stderr, "-L N   also create N files of %d bytes (default 0)\n", MAX_FILE_SIZE);
+  fprintf(stderr, "-f N   create N directories in each directory (default 16)\n");
+  fprintf(stderr, "-l N   nest directories N levels deep (default 2)\n");
+  fprintf(stderr, "-r N   seed the file sizes and contents with N (default 1)\n");
+  fprintf(stderr, "-u     write every change back immediately instead of batching\n");
+  exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[])
+{
+  int numFiles = 20000, maxSize = 2048, numLarge = 0, fanout = 16, depth = 2, seed = 1, unbatched = 0;
+  int opt;
+  while ((opt = getopt(argc, argv, "n:s:L:f:l:r:u")) != -1)
+  {
+    switch (opt)
+    {
+    case 'n':
+      numFiles = atoi(optarg);
+      break;
+    case 's':
+      maxSize = atoi(optarg);
+      break;
+    case 'L':
+      numLarge = atoi(optarg);
+      break;
+    case 'f':
+      fanout = atoi(optarg);
+      break;
+    case 'l':
+      depth = atoi(optarg);
+      break;
+    case 'r':
+      seed = atoi(optarg);
+      break;
+    case 'u':
+      unbatched = 1;
+      break;
+    default:
+      PrintUsageAndExit(argv[0]);
+    }
+  }
+  if (optind != argc - 1 || numFiles < 0 || maxSize < 0 || maxSize > MAX_FILE_SIZE || numLarge < 0 ||
+      fanout < 0 || depth < 0)
+    PrintUsageAndExit(argv[0]);
+
+  // the counts are checked against the inode limit as they grow, so a deep
+  // or wide tree is rejected before the arithmetic can overflow
+  const int maxInodes = MAX_ISIZE * 16;
+  int numDirs = 1;
+  for (int level = 0, width = 1; level < depth && numDirs <= maxInodes; level++)
+  {
+    if (fanout > 0 && width > maxInodes / fanout)
+    {
+      numDirs = maxInodes + 1;
+      break;
+    }
+    width *= fanout;
+    numDirs += width;
+  }
+  if (numDirs > maxInodes || numFiles > maxInodes - numDirs || numLarge > maxInodes - numDirs - numFiles)
+  {
+    fprintf(stderr, "Too many files and directories for one v6 filesystem\n");
+    exit(EXIT_FAILURE);
+  }
+  int isize = (numFiles + numLarge + numDirs + 15) / 16;
+
+  // every file's contents come out of one buffer of random bytes
+  srand(seed);
+  int bufSize = numLarge > 0 ? MAX_FILE_SIZE : maxSize;
+  char *contents = malloc(bufSize > 0 ? bufSize : 1);
+  int *dirs = malloc(numDirs * sizeof(int));
+  if (contents == NULL || dirs == NULL)
+  {
+    fprintf(stderr, "Out of memory.\n");
+    exit(EXIT_FAILURE);
+  }
+  for (int i = 0; i < bufSize; i++)
+    contents[i] = rand();
+
+  char *diskpath = argv[optind];
+  int fd = diskimg_create(diskpath, FS_BLOCKS);
+  if (fd < 0)
+  {
+    fprintf(stderr, "Can't create diskimagePath %s\n", diskpath);
+    exit(EXIT_FAILURE);
+  }
+  double start = Now();
+  struct unixfilesystem *fs = NULL;
+  if (fswrite_mkfs(fd, FS_BLOCKS, isize) < 0 || (fs = unixfilesystem_init(fd)) == NULL)
+  {
+    fprintf(stderr, "Can't make a filesystem on %s\n", diskpath);
+    exit(EXIT_FAILURE);
+  }
+
+  // directories breadth first, so dirs[d]'s children follow every directory above them
+  dirs[0] = ROOT_INUMBER;
+  int made = 1;
+  for (int d = 0; made < numDirs; d++)
+  {
+    for (int k = 0; k < fanout && made < numDirs; k++)
+    {
+      char name[16];
+      sprintf(name, "d%d", k);
+      dirs[made] = fswrite_mkdir(fs, dirs[d], name, 0755);
+      if (dirs[made] < 0)
+      {
+        fprintf(stderr, "Can't make directory %d\n", made);
+        exit(EXIT_FAILURE);
+      }
+      made++;
+      if (unbatched)
+        unixfilesystem_sync(fs);
+    }
+  }
+
+  long bytes = 0;
+  for (int i = 0; i < numFiles; i++)
+  {
+    char name[16];
+    sprintf(name, "f%d", i);
+    int size = (maxSize > 0) ? rand() % (maxSize + 1) : 0;
+    int inumber = fswrite_create(fs, dirs[i % numDirs], name, 0644);
+    if (inumber < 0 || fswrite_append(fs, inumber, contents + (bufSize - size), size) < 0)
+    {
+      fprintf(stderr, "Can't write file %d (the disk may be full)\n", i);
+      exit(EXIT_FAILURE);
+    }
+    bytes += size;
+    if (unbatched)
+      unixfilesystem_sync(fs);
+  }
+  for (int i = 0; i < numLarge; i++)
+  {
+    char name[16];
+    sprintf(name, "large%d", i);
+    int inumber = fswrite_create(fs, dirs[(numFiles + i) % numDirs], name, 0644);
+    if (inumber < 0 || fswrite_append(fs, inumber, contents, MAX_FILE_SIZE) < 0)
+    {
+      fprintf(stderr, "Can't write large file %d (the disk may be full)\n", i);
+      exit(EXIT_FAILURE);
+    }
+    bytes += MAX_FILE_SIZE;
+    if (unbatched)
+      unixfilesystem_sync(fs);
+  }
+  unixfilesystem_free(fs);
+  double elapsed = Now() - start;
+
+  struct diskimg_cachestats stats;
+  diskimg_getcachestats(&stats);
+  printf("%d files in %d directories, %.1f MB, %s writeback\n", numFiles + numLarge, numDirs, bytes / 1e6,
+         unbatched ? "immediate" : "batched");
+  printf("%.0f ms, %.0f files/s, %.1f MB/s, %ld writes, %ld reads\n", elapsed * 1000,
+         (numFiles + numLarge) / elapsed, bytes / 1e6 / elapsed, stats.writes, stats.reads);
+
+  free(contents);
+  free(dirs);
+  if (diskimg_close(fd) < 0)
+    fprintf(stderr, "Error closing %s\n", diskpath);
+  return 0;
+}
@@ -2,30 +2,235 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
 
 #include "diskimg.h"
 
+/**
+ * The sector cache.  Every cached sector lives in one of the slots, which
+ * are chained into hash buckets by (fd, sector) and replaced in CLOCK order:
+ * the hand sweeps the slots, giving any slot that's been referenced since
+ * the last sweep a second chance and evicting the first one that hasn't.
+ */
+struct cacheslot {
+  int fd;                 // -1 if the slot is empty
+  int sectorNum;
+  int next;               // next slot in the same bucket, or -1
+  int referenced;
+  char data[DISKIMG_SECTOR_SIZE];
+};
+
+static struct cacheslot *slots = NULL;
+static int *buckets = NULL;
+static int numSlots = 0;
+static int numBuckets = 0;
+static int clockHand = 0;
+static int cacheConfigured = 0;
+static struct diskimg_cachestats stats;
+static unsigned long writeGeneration = 0; // bumped whenever an image's contents may change
+static pthread_mutex_t cacheLock = PTHREAD_MUTEX_INITIALIZER; // guards everything above
+
+static unsigned int HashSector(int fd, int sectorNum) {
+  return ((unsigned int) sectorNum * 2654435761u) ^ ((unsigned int) fd * 40503u);
+}
+
+/**
+ * Replaces the cache with an empty one of the specified size.  Must be
+ * called with cacheLock held.  Returns 0 on success, -1 on error.
+ */
+static int ResizeCache(int numSectors) {
+  if (numSectors < 0) return -1;
+  struct cacheslot *newSlots = NULL;
+  int *newBuckets = NULL;
+  if (numSectors > 0) {
+    newSlots = malloc(numSectors * sizeof(struct cacheslot));
+    newBuckets = malloc(numSectors * sizeof(int));
+    if (newSlots == NULL || newBuckets == NULL) {
+      free(newSlots);
+      free(newBuckets);
+      return -1;
+    }
+    for (int s = 0; s < numSectors; s++) newSlots[s].fd = -1;
+    for (int b = 0; b < numSectors; b++) newBuckets[b] = -1;
+  }
+  free(slots);
+  free(buckets);
+  slots = newSlots;
+  buckets = newBuckets;
+  numSlots = numBuckets = numSectors;
+  clockHand = 0;
+  cacheConfigured = 1;
+  return 0;
+}
+
+static void InitCacheIfNeeded(void) {
+  if (!cacheConfigured) ResizeCache(DISKIMG_DEFAULT_CACHE_SECTORS);
+}
+
+static int FindSlot(int fd, int sectorNum) {
+  if (numSlots == 0) return -1;
+  for (int s = buckets[HashSector(fd, sectorNum) % numBuckets]; s != -1; s = slots[s].next) {
+    if (slots[s].fd == fd && slots[s].sectorNum == sectorNum) return s;
+  }
+  return -1;
+}
+
+static void UnlinkSlot(int s) {
+  int *link = &buckets[HashSector(slots[s].fd, slots[s].sectorNum) % numBuckets];
+  while (*link != s) link = &slots[*link].next;
+  *link = slots[s].next;
+  slots[s].fd = -1;
+}
+
+/**
+ * Picks a slot for a new sector with the CLOCK algorithm, evicting whatever
+ * was there, and links it into the bucket for (fd, sectorNum).
+ */
+static int ClaimSlot(int fd, int sectorNum) {
+  while (slots[clockHand].fd != -1 && slots[clockHand].referenced) {
+    slots[clockHand].referenced = 0;
+    clockHand = (clockHand + 1) % numSlots;
+  }
+  int s = clockHand;
+  clockHand = (clockHand + 1) % numSlots;
+  if (slots[s].fd != -1) {
+    UnlinkSlot(s);
+    stats.evictions++;
+  }
+  int bucket = HashSector(fd, sectorNum) % numBuckets;
+  slots[s].fd = fd;
+  slots[s].sectorNum = sectorNum;
+  slots[s].referenced = 1;
+  slots[s].next = buckets[bucket];
+  buckets[bucket] = s;
+  return s;
+}
+
 int diskimg_open(char *pathname, int readOnly) {
   return open(pathname, readOnly ? O_RDONLY : O_RDWR);
 }
 
+int diskimg_create(char *pathname, int numSectors) {
+  int fd = open(pathname, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) return -1;
+  if (ftruncate(fd, (off_t) numSectors * DISKIMG_SECTOR_SIZE) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
 int diskimg_getsize(int fd) {
   return lseek(fd, 0, SEEK_END);
 }
 
 int diskimg_readsector(int fd, int sectorNum,  void *buf) {
-  if (lseek(fd, sectorNum * DISKIMG_SECTOR_SIZE, SEEK_SET) == (off_t) -1) return -1;  
-  return read(fd, buf, DISKIMG_SECTOR_SIZE);
+  pthread_mutex_lock(&cacheLock);
+  InitCacheIfNeeded();
+  int s = FindSlot(fd, sectorNum);
+  if (s != -1) {
+    stats.hits++;
+    slots[s].referenced = 1;
+    memcpy(buf, slots[s].data, DISKIMG_SECTOR_SIZE);
+    pthread_mutex_unlock(&cacheLock);
+    return DISKIMG_SECTOR_SIZE;
+  }
+  stats.misses++;
+  stats.reads++;
+  stats.sectors++;
+  unsigned long generation = writeGeneration;
+  pthread_mutex_unlock(&cacheLock);
+
+  // the lock isn't held during the read, so another thread may cache the
+  // sector first, or write it, in which case what was read may be stale
+  // and mustn't be cached
+  int bytesRead = pread(fd, buf, DISKIMG_SECTOR_SIZE, (off_t) sectorNum * DISKIMG_SECTOR_SIZE);
+  if (bytesRead == DISKIMG_SECTOR_SIZE) {
+    pthread_mutex_lock(&cacheLock);
+    if (numSlots > 0 && generation == writeGeneration && FindSlot(fd, sectorNum) == -1) {
+      memcpy(slots[ClaimSlot(fd, sectorNum)].data, buf, DISKIMG_SECTOR_SIZE);
+    }
+    pthread_mutex_unlock(&cacheLock);
+  }
+  return bytesRead;
+}
+
+int diskimg_readsectors(int fd, int firstSector, int numSectors, void *buf) {
+  pthread_mutex_lock(&cacheLock);
+  stats.reads++;
+  stats.sectors += numSectors;
+  pthread_mutex_unlock(&cacheLock);
+  return pread(fd, buf, (size_t) numSectors * DISKIMG_SECTOR_SIZE, (off_t) firstSector * DISKIMG_SECTOR_SIZE);
+}
+
+int diskimg_readahead(int fd, int firstSector, int numSectors) {
+  int err = posix_fadvise(fd, (off_t) firstSector * DISKIMG_SECTOR_SIZE,
+                          (off_t) numSectors * DISKIMG_SECTOR_SIZE, POSIX_FADV_WILLNEED);
+  return err == 0 ? 0 : -1;
 }
 
 int diskimg_writesector(int fd, int sectorNum,  void *buf) {
-  if (lseek(fd, sectorNum * DISKIMG_SECTOR_SIZE, SEEK_SET) == (off_t) -1) {
-    return -1;
+  pthread_mutex_lock(&cacheLock);
+  InitCacheIfNeeded();
+  stats.writes++;
+  writeGeneration++;
+  int bytesWritten = pwrite(fd, buf, DISKIMG_SECTOR_SIZE, (off_t) sectorNum * DISKIMG_SECTOR_SIZE);
+
+  // write-through: keep any cached copy identical to what's on disk
+  int s = FindSlot(fd, sectorNum);
+  if (s != -1) {
+    if (bytesWritten == DISKIMG_SECTOR_SIZE) {
+      memcpy(slots[s].data, buf, DISKIMG_SECTOR_SIZE);
+    } else {
+      UnlinkSlot(s);
+    }
   }
+  pthread_mutex_unlock(&cacheLock);
+  return bytesWritten;
+}
 
-  return write(fd, buf, DISKIMG_SECTOR_SIZE);
+int diskimg_writesectors(int fd, int firstSector, int numSectors, const void *buf) {
+  pthread_mutex_lock(&cacheLock);
+  InitCacheIfNeeded();
+  stats.writes++;
+  writeGeneration++;
+  int bytesWritten = pwrite(fd, buf, (size_t) numSectors * DISKIMG_SECTOR_SIZE,
+                            (off_t) firstSector * DISKIMG_SECTOR_SIZE);
+  for (int i = 0; i < numSectors; i++) {
+    int s = FindSlot(fd, firstSector + i);
+    if (s == -1) continue;
+    if (bytesWritten == numSectors * DISKIMG_SECTOR_SIZE) {
+      memcpy(slots[s].data, (const char *) buf + i * DISKIMG_SECTOR_SIZE, DISKIMG_SECTOR_SIZE);
+    } else {
+      UnlinkSlot(s);
+    }
+  }
+  pthread_mutex_unlock(&cacheLock);
+  return bytesWritten;
 }
 
 int diskimg_close(int fd) {
+  // the descriptor may be reused for another image, so forget its sectors
+  pthread_mutex_lock(&cacheLock);
+  writeGeneration++;
+  for (int s = 0; s < numSlots; s++) {
+    if (slots[s].fd == fd) UnlinkSlot(s);
+  }
+  pthread_mutex_unlock(&cacheLock);
   return close(fd);
 }
+
+int diskimg_setcachesize(int numSectors) {
+  pthread_mutex_lock(&cacheLock);
+  int err = ResizeCache(numSectors);
+  pthread_mutex_unlock(&cacheLock);
+  return err;
+}
+
+void diskimg_getcachestats(struct diskimg_cachestats *statsp) {
+  pthread_mutex_lock(&cacheLock);
+  *statsp = stats;
+  pthread_mutex_unlock(&cacheLock);
+}
@@ -12,6 +12,13 @@
  */
 int diskimg_open(char *pathname, int readOnly);
 
+/**
+ * Creates a disk image of numSectors zeroed sectors (replacing any file
+ * already there) and opens it for reading and writing.  Returns an open file
+ * descriptor, or -1 if unsuccessful.
+ */
+int diskimg_create(char *pathname, int numSectors);
+
 /**
  * Returns the size of the disk imgage in bytes, or -1 if unsuccessful.
  */
@@ -23,16 +30,69 @@ int diskimg_getsize(int fd);
  */
 int diskimg_readsector(int fd, int sectorNum, void *buf); 
 
+/**
+ * Reads numSectors consecutive sectors, starting with firstSector, into buf
+ * with a single system call.  Bulk reads like this bypass the sector cache
+ * (which writes always go through, so the disk is never stale).  Returns the
+ * number of bytes read, or -1 on error.
+ */
+int diskimg_readsectors(int fd, int firstSector, int numSectors, void *buf);
+
+/**
+ * Tells the kernel the specified run of sectors will be read soon, so it can
+ * start reading them in the background.  Returns 0 on success, -1 on error.
+ */
+int diskimg_readahead(int fd, int firstSector, int numSectors);
+
 /**
  * Writes the specified sector from the disk.  Returns the number of bytes
  * written, or -1 on error.
  */
 int diskimg_writesector(int fd, int sectorNum, void *buf); 
 
+/**
+ * Writes numSectors consecutive sectors, starting with firstSector, from buf
+ * with a single system call, updating any cached copies.  Returns the number
+ * of bytes written, or -1 on error.
+ */
+int diskimg_writesectors(int fd, int firstSector, int numSectors, const void *buf);
+
 /**
  * Clean up from a previous diskimg_open() call.  Returns 0 on success, or -1 on
  * error.
  */
 int diskimg_close(int fd);
 
+/**
+ * Every sector read goes through a sector cache shared by all open disk
+ * images, so that the sectors read over and over (inode sectors, indirect
+ * blocks, directory blocks) are only read from the disk once.  Writes go
+ * straight through to the disk and update any cached copy.  Replacement is
+ * CLOCK (second chance), and the cache holds DISKIMG_DEFAULT_CACHE_SECTORS
+ * sectors unless diskimg_setcachesize() says otherwise.  Any number of
+ * threads may read and write sectors at once.
+ */
+#define DISKIMG_DEFAULT_CACHE_SECTORS 1024
+
+struct diskimg_cachestats {
+  long hits;       // reads answered from the cache
+  long misses;     // reads that had to go to the disk
+  long evictions;  // cached sectors dropped to make room for others
+  long reads;      // read system calls issued
+  long sectors;    // sectors those read system calls transferred
+  long writes;     // write system calls issued
+};
+
+/**
+ * Sets the number of sectors the cache can hold, discarding everything
+ * cached so far.  A size of 0 turns the cache off.  Returns 0 on success, or
+ * -1 on error (in which case the cache is left as it was).
+ */
+int diskimg_setcachesize(int numSectors);
+
+/**
+ * Copies the counters accumulated since the program started into stats.
+ */
+void diskimg_getcachestats(struct diskimg_cachestats *stats);
+
 #endif // _DISKIMG_H_
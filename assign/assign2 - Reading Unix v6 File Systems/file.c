@@ -1,4 +1,6 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 
 #include "file.h"
@@ -10,6 +12,19 @@
  * Returns the number of valid bytes in the block, -1 on error.
  */
 int file_getblock(struct unixfilesystem *fs, int inumber, int blockNum, void *buf)
+{
+	const void *data;
+	int validBytes = file_getblockdata(fs, inumber, blockNum, buf, &data);
+	if (validBytes >= 0 && data != buf)
+		memcpy(buf, data, DISKIMG_SECTOR_SIZE);
+	return validBytes;
+}
+
+/**
+ * Fetches the specified file block from the specified inode, in place if the
+ * filesystem is mapped.  Returns the number of valid bytes in the block, -1 on error.
+ */
+int file_getblockdata(struct unixfilesystem *fs, int inumber, int blockNum, void *buf, const void **data)
 {
 	struct inode ino;
 	// Reading from fs
@@ -18,7 +33,7 @@ int file_getblock(struct unixfilesystem *fs, int inumber, int blockNum, void *bu
 		return -1;
 	if ((diskBlockNum = inode_indexlookup(fs, &ino, blockNum)) == -1)
 		return -1;
-	if (diskimg_readsector(fs->dfd, diskBlockNum, buf) != DISKIMG_SECTOR_SIZE)
+	if ((*data = unixfilesystem_getsector(fs, diskBlockNum, buf)) == NULL)
 		return -1;
 	// Calculating the valid bytes in the block
 	int fileSize = inode_getsize(&ino);
@@ -29,3 +44,148 @@ int file_getblock(struct unixfilesystem *fs, int inumber, int blockNum, void *bu
 		return DISKIMG_SECTOR_SIZE;
 	return 0;
 }
+
+/**
+ * Opens the file with the specified inumber, resolving its whole block map.
+ * Returns 0 on success, -1 on error.
+ */
+int file_open(struct unixfilesystem *fs, int inumber, struct openfile *fp)
+{
+	fp->fs = fs;
+	fp->inumber = inumber;
+	fp->blocks = NULL;
+	fp->readahead = 0;
+	fp->advisedUpTo = 0;
+	if (inode_iget(fs, inumber, &fp->in) == -1 || (fp->in.i_mode & IALLOC) == 0)
+		return -1;
+	fp->size = inode_getsize(&fp->in);
+	fp->numBlocks = (fp->size + DISKIMG_SECTOR_SIZE - 1) / DISKIMG_SECTOR_SIZE;
+	fp->blocks = malloc((fp->numBlocks > 0 ? fp->numBlocks : 1) * sizeof(uint16_t));
+	if (fp->blocks == NULL)
+		return -1;
+	if (inode_blockmap(fs, &fp->in, fp->blocks, fp->numBlocks) == -1)
+	{
+		file_close(fp);
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Fetches the specified block of an open file, in place if the filesystem
+ * is mapped.  Returns the number of valid bytes in the block, -1 on error.
+ */
+int file_readblock(struct openfile *fp, int blockNum, void *buf, const void **data)
+{
+	if (blockNum < 0 || blockNum >= fp->numBlocks)
+		return -1;
+	if ((*data = unixfilesystem_getsector(fp->fs, fp->blocks[blockNum], buf)) == NULL)
+		return -1;
+	if (blockNum < fp->numBlocks - 1 || fp->size % DISKIMG_SECTOR_SIZE == 0)
+		return DISKIMG_SECTOR_SIZE;
+	return fp->size % DISKIMG_SECTOR_SIZE;
+}
+
+/**
+ * Returns the length of the run of file blocks starting at fileBlock (and
+ * ending no later than lastBlock) that are also consecutive on disk.
+ */
+static int RunLength(struct openfile *fp, int fileBlock, int lastBlock)
+{
+	int count = 1;
+	while (fileBlock + count < lastBlock && fp->blocks[fileBlock + count] == fp->blocks[fileBlock] + count)
+		count++;
+	return count;
+}
+
+/**
+ * Hints that the blocks up to lastBlock will be read soon, skipping any
+ * that have already been hinted.
+ */
+static void ReadAhead(struct openfile *fp, int lastBlock)
+{
+	if (lastBlock > fp->numBlocks)
+		lastBlock = fp->numBlocks;
+	while (fp->advisedUpTo < lastBlock)
+	{
+		int count = RunLength(fp, fp->advisedUpTo, lastBlock);
+		(void)unixfilesystem_readahead(fp->fs, fp->blocks[fp->advisedUpTo], count);
+		fp->advisedUpTo += count;
+	}
+}
+
+/**
+ * Reads a span of blocks of an open file, one system call per run of blocks
+ * that are contiguous on disk.  Returns the number of valid bytes, -1 on error.
+ */
+int file_readblocks(struct openfile *fp, int firstBlock, int numBlocks, void *buf)
+{
+	if (firstBlock < 0 || numBlocks < 0 || firstBlock + numBlocks > fp->numBlocks)
+		return -1;
+	int lastBlock = firstBlock + numBlocks;
+	if (fp->readahead > 0)
+	{
+		if (fp->advisedUpTo < lastBlock)
+			fp->advisedUpTo = lastBlock;
+		ReadAhead(fp, lastBlock + fp->readahead);
+	}
+	for (int block = firstBlock; block < lastBlock;)
+	{
+		int count = RunLength(fp, block, lastBlock);
+		char *dest = (char *)buf + (block - firstBlock) * DISKIMG_SECTOR_SIZE;
+		if (unixfilesystem_getsectors(fp->fs, fp->blocks[block], count, dest) < 0)
+			return -1;
+		block += count;
+	}
+	int end = lastBlock * DISKIMG_SECTOR_SIZE;
+	if (end > fp->size)
+		end = fp->size;
+	return end - firstBlock * DISKIMG_SECTOR_SIZE;
+}
+
+/**
+ * Sets how many blocks file_readblocks should read ahead.
+ */
+void file_setreadahead(struct openfile *fp, int numBlocks)
+{
+	fp->readahead = numBlocks;
+}
+
+/**
+ * Copies up to length bytes from the specified offset of an open file.
+ * Returns the number of bytes copied, -1 on error.
+ */
+int file_read(struct openfile *fp, int offset, void *buf, int length)
+{
+	if (offset < 0 || length < 0)
+		return -1;
+	if (offset >= fp->size)
+		return 0;
+	if (length > fp->size - offset)
+		length = fp->size - offset;
+	int copied = 0;
+	while (copied < length)
+	{
+		char sector[DISKIMG_SECTOR_SIZE];
+		const void *data;
+		int blockNum = (offset + copied) / DISKIMG_SECTOR_SIZE;
+		int blockOffset = (offset + copied) % DISKIMG_SECTOR_SIZE;
+		if (file_readblock(fp, blockNum, sector, &data) == -1)
+			return -1;
+		int chunk = DISKIMG_SECTOR_SIZE - blockOffset;
+		if (chunk > length - copied)
+			chunk = length - copied;
+		memcpy((char *)buf + copied, (const char *)data + blockOffset, chunk);
+		copied += chunk;
+	}
+	return copied;
+}
+
+/**
+ * Releases the block map of an open file.
+ */
+void file_close(struct openfile *fp)
+{
+	free(fp->blocks);
+	fp->blocks = NULL;
+}
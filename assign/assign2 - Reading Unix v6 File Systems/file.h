@@ -9,4 +9,69 @@
  */
 int file_getblock(struct unixfilesystem *fs, int inumber, int blockNo, void *buf); 
 
+/**
+ * Like file_getblock, but instead of always copying the block into buf, sets
+ * *data to the address of its contents: inside the mapped image with the
+ * UNIXFILESYSTEM_MMAP backend, or buf otherwise.  The contents are read-only.
+ * Returns the number of valid bytes in the block, -1 on error.
+ */
+int file_getblockdata(struct unixfilesystem *fs, int inumber, int blockNo, void *buf, const void **data);
+
+/**
+ * An open file: its inode, decoded once, and the disk block number of every
+ * one of its blocks, resolved once when it's opened.  Reading any block of an
+ * open file therefore costs exactly one sector read, and opening a file costs
+ * one read of its inode plus one read of each of its indirect blocks.
+ */
+struct openfile {
+  struct unixfilesystem *fs;
+  int inumber;
+  struct inode in;
+  int size;          // in bytes
+  int numBlocks;
+  uint16_t *blocks;  // blocks[i] is the disk block holding file block i
+  int readahead;     // number of blocks to read ahead of file_readblocks, 0 for none
+  int advisedUpTo;   // file blocks before this one have already been read ahead
+};
+
+/**
+ * Opens the file with the specified inumber, filling in *fp.  Returns 0 on
+ * success, -1 on error (including if the inode isn't allocated).
+ */
+int file_open(struct unixfilesystem *fs, int inumber, struct openfile *fp);
+
+/**
+ * Same contract as file_getblockdata, but for a file opened with file_open.
+ */
+int file_readblock(struct openfile *fp, int blockNum, void *buf, const void **data);
+
+/**
+ * Reads numBlocks consecutive file blocks, starting with firstBlock, into buf
+ * (which must hold numBlocks * DISKIMG_SECTOR_SIZE bytes).  Blocks that also
+ * sit next to each other on the disk are read together, with a single system
+ * call per contiguous run.  Returns the number of valid bytes read, or -1 on
+ * error.
+ */
+int file_readblocks(struct openfile *fp, int firstBlock, int numBlocks, void *buf);
+
+/**
+ * Turns on sequential readahead for an open file: every file_readblocks call
+ * also hints that the following numBlocks blocks will be wanted soon, so the
+ * disk can fetch them while the caller works on the current ones.  A
+ * numBlocks of 0 turns readahead off again.
+ */
+void file_setreadahead(struct openfile *fp, int numBlocks);
+
+/**
+ * Copies up to length bytes starting at the specified offset into buf.
+ * Returns the number of bytes copied (0 at or past the end of the file),
+ * or -1 on error.
+ */
+int file_read(struct openfile *fp, int offset, void *buf, int length);
+
+/**
+ * Releases the block map of a file opened with file_open.
+ */
+void file_close(struct openfile *fp);
+
 #endif // _FILE_H_
@@ -0,0 +1,639 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "fswrite.h"
+#include "alloc.h"
+#include "inode.h"
+#include "diskimg.h"
+#include "directory.h"
+#include "dircache.h"
+
+#define NADDR 8
+#define DIND 7
+#define PTRS_PER_BLOCK ((int)(DISKIMG_SECTOR_SIZE / sizeof(uint16_t)))
+#define MAX_FILE_SIZE 0xffffff
+#define MAX_FS_BLOCKS 0xffff
+#define DIR_MAX_LEN 14
+
+/**
+ * An indirect block being updated.  Appends keep the singly and doubly
+ * indirect blocks they're filling in one of these, so each is read and
+ * written only once however many of its entries change.
+ */
+struct indirect
+{
+	int blockNum;  // -1 if none is loaded
+	int dirty;
+	uint16_t map[DISKIMG_SECTOR_SIZE / sizeof(uint16_t)];
+};
+
+/**
+ * The blocks an append has taken off the free list, so that every one of
+ * them can be put back if it fails partway.
+ */
+struct newblocks
+{
+	int *blocks;
+	int count;
+	int capacity;
+};
+
+/**
+ * Sets a v6 time (stored the way the PDP-11 stored a long: high word first)
+ * to now.
+ */
+static void SetTime(uint16_t t[2])
+{
+	time_t now = time(NULL);
+	t[0] = (uint16_t)(now >> 16);
+	t[1] = (uint16_t)now;
+}
+
+static int AllocBlock(struct unixfilesystem *fs, struct newblocks *nb)
+{
+	if (nb->count == nb->capacity)
+		return -1;
+	int blockNum = alloc_block(fs);
+	if (blockNum >= 0)
+		nb->blocks[nb->count++] = blockNum;
+	return blockNum;
+}
+
+static int FlushIndirect(struct unixfilesystem *fs, struct indirect *ind)
+{
+	if (ind->blockNum == -1 || !ind->dirty)
+		return 0;
+	if (diskimg_writesector(fs->dfd, ind->blockNum, ind->map) != DISKIMG_SECTOR_SIZE)
+		return -1;
+	ind->dirty = 0;
+	return 0;
+}
+
+/**
+ * Makes ind hold the specified indirect block, writing back whichever one it
+ * held before.  A fresh block was just allocated, so it starts out zeroed
+ * rather than being read.
+ */
+static int LoadIndirect(struct unixfilesystem *fs, struct indirect *ind, int blockNum, int fresh)
+{
+	if (ind->blockNum == blockNum)
+		return 0;
+	if (FlushIndirect(fs, ind) < 0)
+		return -1;
+	ind->blockNum = -1;
+	if (fresh)
+	{
+		memset(ind->map, 0, sizeof(ind->map));
+		ind->dirty = 1;
+	}
+	else
+	{
+		const void *data = unixfilesystem_getsector(fs, blockNum, ind->map);
+		if (data == NULL)
+			return -1;
+		if (data != ind->map)
+			memcpy(ind->map, data, sizeof(ind->map));
+		ind->dirty = 0;
+	}
+	ind->blockNum = blockNum;
+	return 0;
+}
+
+/**
+ * Makes the specified indirect slot point at a newly allocated indirect
+ * block, unless it already points somewhere, then loads that block into ind.
+ */
+static int LoadOrAllocIndirect(struct unixfilesystem *fs, struct indirect *ind, uint16_t *slot,
+							   struct newblocks *nb)
+{
+	int fresh = 0;
+	if (*slot == 0)
+	{
+		int blockNum = AllocBlock(fs, nb);
+		if (blockNum < 0)
+			return -1;
+		*slot = blockNum;
+		fresh = 1;
+	}
+	return LoadIndirect(fs, ind, *slot, fresh);
+}
+
+/**
+ * Records that file block blockNum lives in disk block diskBlock, switching
+ * the file over to the large (ILARG) layout when it outgrows its 8 direct
+ * blocks, the way v6's bmap does: the direct block numbers move into a new
+ * singly indirect block that becomes i_addr[0].
+ */
+static int MapBlock(struct unixfilesystem *fs, struct inode *in, struct indirect *single,
+					struct indirect *dbl, int blockNum, int diskBlock, struct newblocks *nb)
+{
+	if ((in->i_mode & ILARG) == 0)
+	{
+		if (blockNum < NADDR)
+		{
+			in->i_addr[blockNum] = diskBlock;
+			return 0;
+		}
+		int indBlock = AllocBlock(fs, nb);
+		if (indBlock < 0 || LoadIndirect(fs, single, indBlock, 1) < 0)
+			return -1;
+		memcpy(single->map, in->i_addr, sizeof(in->i_addr));
+		memset(in->i_addr, 0, sizeof(in->i_addr));
+		in->i_addr[0] = indBlock;
+		in->i_mode |= ILARG;
+	}
+
+	if (blockNum < DIND * PTRS_PER_BLOCK)
+	{
+		if (LoadOrAllocIndirect(fs, single, &in->i_addr[blockNum / PTRS_PER_BLOCK], nb) < 0)
+			return -1;
+	}
+	else
+	{
+		blockNum -= DIND * PTRS_PER_BLOCK;
+		if (LoadOrAllocIndirect(fs, dbl, &in->i_addr[DIND], nb) < 0)
+			return -1;
+		uint16_t before = dbl->map[blockNum / PTRS_PER_BLOCK];
+		if (LoadOrAllocIndirect(fs, single, &dbl->map[blockNum / PTRS_PER_BLOCK], nb) < 0)
+			return -1;
+		if (dbl->map[blockNum / PTRS_PER_BLOCK] != before)
+			dbl->dirty = 1;
+	}
+	single->map[blockNum % PTRS_PER_BLOCK] = diskBlock;
+	single->dirty = 1;
+	return 0;
+}
+
+static int WriteRun(struct unixfilesystem *fs, int firstBlock, int numBlocks, const char *data)
+{
+	if (numBlocks == 0)
+		return 0;
+	int length = numBlocks * DISKIMG_SECTOR_SIZE;
+	return (diskimg_writesectors(fs->dfd, firstBlock, numBlocks, data) == length) ? 0 : -1;
+}
+
+/**
+ * Zeroes the entries of an indirect block from first onward, writing it back
+ * only if that changes it.
+ */
+static int TruncateIndirect(struct unixfilesystem *fs, int blockNum, int first)
+{
+	uint16_t map[PTRS_PER_BLOCK];
+	const uint16_t *data = unixfilesystem_getsector(fs, blockNum, map);
+	if (data == NULL)
+		return -1;
+	if (data != map)
+		memcpy(map, data, sizeof(map));
+	int changed = 0;
+	for (int i = first; i < PTRS_PER_BLOCK; i++)
+	{
+		changed |= map[i] != 0;
+		map[i] = 0;
+	}
+	if (changed && diskimg_writesector(fs->dfd, blockNum, map) != DISKIMG_SECTOR_SIZE)
+		return -1;
+	return 0;
+}
+
+/**
+ * Undoes a failed append to a file whose inode (as it still is on disk) is
+ * orig and which had firstNew blocks: the indirect blocks it already had lose
+ * any entries past those, which the append may have written out, and then
+ * every block the append allocated goes back on the free list.
+ */
+static void UndoAppend(struct unixfilesystem *fs, const struct inode *orig, int firstNew,
+					   const struct newblocks *nb)
+{
+	if (orig->i_mode & ILARG)
+	{
+		// only the indirect blocks holding the end of the file can have changed,
+		// since any after them are new
+		if (firstNew < DIND * PTRS_PER_BLOCK && orig->i_addr[firstNew / PTRS_PER_BLOCK] != 0)
+			TruncateIndirect(fs, orig->i_addr[firstNew / PTRS_PER_BLOCK], firstNew % PTRS_PER_BLOCK);
+		if (orig->i_addr[DIND] != 0)
+		{
+			int first = (firstNew > DIND * PTRS_PER_BLOCK) ? firstNew - DIND * PTRS_PER_BLOCK : 0;
+			uint16_t map[PTRS_PER_BLOCK];
+			const uint16_t *data = unixfilesystem_getsector(fs, orig->i_addr[DIND], map);
+			if (data != NULL && first % PTRS_PER_BLOCK != 0 && data[first / PTRS_PER_BLOCK] != 0)
+				TruncateIndirect(fs, data[first / PTRS_PER_BLOCK], first % PTRS_PER_BLOCK);
+			TruncateIndirect(fs, orig->i_addr[DIND], (first + PTRS_PER_BLOCK - 1) / PTRS_PER_BLOCK);
+		}
+	}
+	for (int i = nb->count - 1; i >= 0; i--)
+		alloc_freeblock(fs, nb->blocks[i]);
+}
+
+int fswrite_append(struct unixfilesystem *fs, int inumber, const void *buf, int length)
+{
+	struct inode in;
+	if (inode_iget(fs, inumber, &in) < 0 || (in.i_mode & IALLOC) == 0)
+		return -1;
+	int size = inode_getsize(&in);
+	if (length < 0 || length > MAX_FILE_SIZE - size)
+		return -1;
+	const char *data = buf;
+	char block[DISKIMG_SECTOR_SIZE];
+	int done = 0;
+
+	// first fill up the partly used last block, if there is one
+	int used = size % DISKIMG_SECTOR_SIZE;
+	if (used > 0 && length > 0)
+	{
+		int diskBlock = inode_indexlookup(fs, &in, size / DISKIMG_SECTOR_SIZE);
+		if (diskBlock < 0 || diskimg_readsector(fs->dfd, diskBlock, block) != DISKIMG_SECTOR_SIZE)
+			return -1;
+		done = (length < DISKIMG_SECTOR_SIZE - used) ? length : DISKIMG_SECTOR_SIZE - used;
+		memcpy(block + used, data, done);
+		if (diskimg_writesector(fs->dfd, diskBlock, block) != DISKIMG_SECTOR_SIZE)
+			return -1;
+	}
+
+	// then new blocks, written straight out of buf a contiguous run at a time
+	const struct inode orig = in;
+	int firstNew = (size + done + DISKIMG_SECTOR_SIZE - 1) / DISKIMG_SECTOR_SIZE;
+	int numData = (length - done + DISKIMG_SECTOR_SIZE - 1) / DISKIMG_SECTOR_SIZE;
+	struct newblocks nb;
+	nb.count = 0;
+	// each indirect block maps PTRS_PER_BLOCK data blocks, and the run may
+	// straddle two of them, need the doubly indirect block, and convert the
+	// file to ILARG
+	nb.capacity = numData + numData / PTRS_PER_BLOCK + 4;
+	nb.blocks = malloc(nb.capacity * sizeof(int));
+	if (nb.blocks == NULL)
+		return -1;
+	struct indirect single, dbl;
+	single.blockNum = dbl.blockNum = -1;
+	single.dirty = dbl.dirty = 0;
+	int blockNum = firstNew;
+	int runStart = 0, runLength = 0;
+	const char *runData = NULL;
+	int err = 0;
+	while (done < length && !err)
+	{
+		int diskBlock = AllocBlock(fs, &nb);
+		if (diskBlock < 0 || MapBlock(fs, &in, &single, &dbl, blockNum, diskBlock, &nb) < 0)
+		{
+			err = 1;
+			break;
+		}
+		int n = length - done;
+		if (n >= DISKIMG_SECTOR_SIZE)
+		{
+			n = DISKIMG_SECTOR_SIZE;
+			if (runLength == 0 || diskBlock != runStart + runLength)
+			{
+				err = WriteRun(fs, runStart, runLength, runData) < 0;
+				runStart = diskBlock;
+				runLength = 0;
+				runData = data + done;
+			}
+			runLength++;
+		}
+		else
+		{
+			// the last block is partly used, so it gets padded with zeroes
+			memset(block, 0, sizeof(block));
+			memcpy(block, data + done, n);
+			err = diskimg_writesector(fs->dfd, diskBlock, block) != DISKIMG_SECTOR_SIZE;
+		}
+		done += n;
+		blockNum++;
+	}
+	if (!err)
+	{
+		inode_setsize(&in, size + length);
+		SetTime(in.i_mtime);
+		err = WriteRun(fs, runStart, runLength, runData) < 0 ||
+			FlushIndirect(fs, &single) < 0 || FlushIndirect(fs, &dbl) < 0 ||
+			inode_iput(fs, inumber, &in) < 0;
+	}
+	if (err)
+	{
+		// the inode on disk hasn't changed, so it mustn't be left pointing at
+		// any of the new blocks, nor they be lost from the free list
+		UndoAppend(fs, &orig, firstNew, &nb);
+	}
+	free(nb.blocks);
+	return err ? -1 : 0;
+}
+
+/**
+ * Frees an indirect block and every block it points to (through one more
+ * level of indirection if doubly is set).
+ */
+static int FreeIndirect(struct unixfilesystem *fs, int blockNum, int doubly)
+{
+	uint16_t map[PTRS_PER_BLOCK];
+	const uint16_t *data = unixfilesystem_getsector(fs, blockNum, map);
+	if (data == NULL)
+		return -1;
+	if (data != map)
+		memcpy(map, data, sizeof(map));
+	for (int i = 0; i < PTRS_PER_BLOCK; i++)
+	{
+		if (map[i] == 0)
+			continue;
+		if ((doubly ? FreeIndirect(fs, map[i], 0) : alloc_freeblock(fs, map[i])) < 0)
+			return -1;
+	}
+	return alloc_freeblock(fs, blockNum);
+}
+
+/**
+ * Frees every block of a file, leaving it empty.
+ */
+static int FreeBlocks(struct unixfilesystem *fs, struct inode *in)
+{
+	for (int i = 0; i < NADDR; i++)
+	{
+		if (in->i_addr[i] == 0)
+			continue;
+		int err;
+		if ((in->i_mode & ILARG) == 0)
+			err = alloc_freeblock(fs, in->i_addr[i]);
+		else
+			err = FreeIndirect(fs, in->i_addr[i], i == DIND);
+		if (err < 0)
+			return -1;
+		in->i_addr[i] = 0;
+	}
+	in->i_mode &= ~ILARG;
+	inode_setsize(in, 0);
+	return 0;
+}
+
+/**
+ * Allocates an inode and writes it out as an empty file with the specified
+ * mode (which gets IALLOC added) and link count.  Returns its inumber.
+ */
+static int NewInode(struct unixfilesystem *fs, int mode, int nlink)
+{
+	int inumber = alloc_inode(fs);
+	if (inumber < 0)
+		return -1;
+	struct inode in;
+	memset(&in, 0, sizeof(in));
+	in.i_mode = IALLOC | mode;
+	in.i_nlink = nlink;
+	SetTime(in.i_atime);
+	SetTime(in.i_mtime);
+	if (inode_iput(fs, inumber, &in) < 0)
+		return -1;
+	return inumber;
+}
+
+/**
+ * Frees an inode and whatever blocks it still has.
+ */
+static int ReleaseInode(struct unixfilesystem *fs, int inumber)
+{
+	struct inode in;
+	if (inode_iget(fs, inumber, &in) < 0 || FreeBlocks(fs, &in) < 0)
+		return -1;
+	memset(&in, 0, sizeof(in));
+	if (inode_iput(fs, inumber, &in) < 0)
+		return -1;
+	alloc_freeinode(fs, inumber);
+	return 0;
+}
+
+static int IsDotOrDotDot(const char *name)
+{
+	return strcmp(name, ".") == 0 || strcmp(name, "..") == 0;
+}
+
+/**
+ * Checks that name could be added to the directory with the specified
+ * inumber: that it's a valid name, that the directory is one, and that
+ * nothing there already has the name.  This also leaves the directory
+ * indexed, so AddEntry knows where its first unused entry is.
+ */
+static int CheckNewName(struct unixfilesystem *fs, int dirinumber, const char *name)
+{
+	int length = strlen(name);
+	if (length == 0 || length > DIR_MAX_LEN || strchr(name, '/') != NULL || IsDotOrDotDot(name))
+		return -1;
+	struct inode dir;
+	if (inode_iget(fs, dirinumber, &dir) < 0 || (dir.i_mode & IALLOC) == 0 || (dir.i_mode & IFMT) != IFDIR)
+		return -1;
+	struct direntv6 d;
+	return (dircache_findname(fs, name, dirinumber, &d) == 0) ? -1 : 0;
+}
+
+/**
+ * Overwrites the directory entry at the specified byte offset.
+ */
+static int WriteEntry(struct unixfilesystem *fs, int dirinumber, int offset, const struct direntv6 *d)
+{
+	struct inode dir;
+	if (inode_iget(fs, dirinumber, &dir) < 0)
+		return -1;
+	int diskBlock = inode_indexlookup(fs, &dir, offset / DISKIMG_SECTOR_SIZE);
+	char block[DISKIMG_SECTOR_SIZE];
+	if (diskBlock < 0 || diskimg_readsector(fs->dfd, diskBlock, block) != DISKIMG_SECTOR_SIZE)
+		return -1;
+	memcpy(block + offset % DISKIMG_SECTOR_SIZE, d, sizeof(*d));
+	if (diskimg_writesector(fs->dfd, diskBlock, block) != DISKIMG_SECTOR_SIZE)
+		return -1;
+	SetTime(dir.i_mtime);
+	return inode_iput(fs, dirinumber, &dir);
+}
+
+/**
+ * Adds an entry to a directory CheckNewName has approved, in its first
+ * unused entry if it has one, or at its end otherwise.
+ */
+static int AddEntry(struct unixfilesystem *fs, int dirinumber, const char *name, int inumber)
+{
+	struct direntv6 d;
+	memset(&d, 0, sizeof(d));
+	d.d_inumber = inumber;
+	strncpy(d.d_name, name, sizeof(d.d_name));
+
+	int offset = dircache_freeslot(fs, dirinumber);
+	if (offset >= 0)
+	{
+		if (WriteEntry(fs, dirinumber, offset, &d) < 0)
+			return -1;
+	}
+	else
+	{
+		struct inode dir;
+		if (inode_iget(fs, dirinumber, &dir) < 0)
+			return -1;
+		offset = inode_getsize(&dir);
+		if (fswrite_append(fs, dirinumber, &d, sizeof(d)) < 0)
+			return -1;
+	}
+	dircache_addname(fs, dirinumber, &d, offset);
+	return 0;
+}
+
+/**
+ * Adds delta to the link count of the specified inode.
+ */
+static int AdjustLinks(struct unixfilesystem *fs, int inumber, int delta)
+{
+	struct inode in;
+	if (inode_iget(fs, inumber, &in) < 0)
+		return -1;
+	in.i_nlink += delta;
+	return inode_iput(fs, inumber, &in);
+}
+
+int fswrite_create(struct unixfilesystem *fs, int dirinumber, const char *name, int mode)
+{
+	if (CheckNewName(fs, dirinumber, name) < 0)
+		return -1;
+	int inumber = NewInode(fs, mode & 07777, 1);
+	if (inumber < 0)
+		return -1;
+	if (AddEntry(fs, dirinumber, name, inumber) < 0)
+	{
+		ReleaseInode(fs, inumber);
+		return -1;
+	}
+	return inumber;
+}
+
+/**
+ * Writes the "." and ".." entries of a new directory.
+ */
+static int InitDirectory(struct unixfilesystem *fs, int inumber, int parentinumber)
+{
+	struct direntv6 entries[2];
+	memset(entries, 0, sizeof(entries));
+	entries[0].d_inumber = inumber;
+	strcpy(entries[0].d_name, ".");
+	entries[1].d_inumber = parentinumber;
+	strcpy(entries[1].d_name, "..");
+	return fswrite_append(fs, inumber, entries, sizeof(entries));
+}
+
+int fswrite_mkdir(struct unixfilesystem *fs, int dirinumber, const char *name, int mode)
+{
+	if (CheckNewName(fs, dirinumber, name) < 0)
+		return -1;
+	int inumber = NewInode(fs, IFDIR | (mode & 07777), 2);
+	if (inumber < 0)
+		return -1;
+	if (InitDirectory(fs, inumber, dirinumber) < 0 || AddEntry(fs, dirinumber, name, inumber) < 0)
+	{
+		ReleaseInode(fs, inumber);
+		return -1;
+	}
+	// the new directory's ".." refers to its parent
+	return (AdjustLinks(fs, dirinumber, 1) < 0) ? -1 : inumber;
+}
+
+/**
+ * Returns 1 if the specified directory has nothing but "." and "..", 0 if it
+ * has anything else, -1 if it can't be read.
+ */
+static int IsEmptyDirectory(struct unixfilesystem *fs, int inumber)
+{
+	struct direntiter it;
+	if (directory_open(fs, inumber, &it) < 0)
+		return -1;
+	struct direntv6 d;
+	int more, empty = 1;
+	while (empty && (more = directory_next(&it, &d)) > 0)
+	{
+		char name[DIR_MAX_LEN + 1];
+		memcpy(name, d.d_name, DIR_MAX_LEN);
+		name[DIR_MAX_LEN] = '\0';
+		if (d.d_inumber != 0 && !IsDotOrDotDot(name))
+			empty = 0;
+	}
+	directory_close(&it);
+	return (more < 0) ? -1 : empty;
+}
+
+int fswrite_unlink(struct unixfilesystem *fs, int dirinumber, const char *name)
+{
+	if (IsDotOrDotDot(name))
+		return -1;
+	struct direntv6 d;
+	int offset;
+	if (dircache_findentry(fs, name, dirinumber, &d, &offset) < 0)
+		return -1;
+	int inumber = d.d_inumber;
+	struct inode in;
+	if (inode_iget(fs, inumber, &in) < 0)
+		return -1;
+	int isDir = (in.i_mode & IFMT) == IFDIR;
+	if (isDir && IsEmptyDirectory(fs, inumber) != 1)
+		return -1;
+
+	// As in v6, an unused entry keeps its name and only loses its inumber.
+	d.d_inumber = 0;
+	if (WriteEntry(fs, dirinumber, offset, &d) < 0)
+		return -1;
+	dircache_invalidate(fs, dirinumber);
+
+	if (isDir)
+	{
+		// Both the entry just removed and the directory's own "." are gone,
+		// along with its ".." reference to the parent.
+		dircache_invalidate(fs, inumber);
+		if (AdjustLinks(fs, dirinumber, -1) < 0)
+			return -1;
+		in.i_nlink = 0;
+	}
+	else if (in.i_nlink > 0)
+	{
+		in.i_nlink--;
+	}
+	if (in.i_nlink > 0)
+		return inode_iput(fs, inumber, &in);
+	return ReleaseInode(fs, inumber);
+}
+
+int fswrite_mkfs(int dfd, int fsize, int isize)
+{
+	int numInodes = isize * (DISKIMG_SECTOR_SIZE / sizeof(struct inode));
+	if (isize < 1 || numInodes > MAX_FS_BLOCKS || fsize > MAX_FS_BLOCKS ||
+		fsize <= INODE_START_SECTOR + isize)
+		return -1;
+
+	char block[DISKIMG_SECTOR_SIZE];
+	memset(block, 0, sizeof(block));
+	uint16_t magic = BOOTBLOCK_MAGIC_NUM;
+	memcpy(block, &magic, sizeof(magic));
+	if (diskimg_writesector(dfd, BOOTBLOCK_SECTOR, block) != DISKIMG_SECTOR_SIZE)
+		return -1;
+
+	struct filsys sb;
+	memset(&sb, 0, sizeof(sb));
+	sb.s_isize = isize;
+	sb.s_fsize = fsize;
+	if (diskimg_writesector(dfd, SUPERBLOCK_SECTOR, &sb) != DISKIMG_SECTOR_SIZE)
+		return -1;
+
+	char *inodes = calloc(isize, DISKIMG_SECTOR_SIZE);
+	if (inodes == NULL)
+		return -1;
+	int err = diskimg_writesectors(dfd, INODE_START_SECTOR, isize, inodes) != isize * DISKIMG_SECTOR_SIZE;
+	free(inodes);
+	if (err)
+		return -1;
+
+	struct unixfilesystem *fs = unixfilesystem_init(dfd);
+	if (fs == NULL)
+		return -1;
+	// Freed from the top down, the blocks are allocated from the bottom up.
+	for (int blockNum = fsize - 1; blockNum >= INODE_START_SECTOR + isize && !err; blockNum--)
+		err = alloc_freeblock(fs, blockNum) < 0;
+	if (!err)
+	{
+		int root = NewInode(fs, IFDIR | 0755, 2);
+		err = root != ROOT_INUMBER || InitDirectory(fs, root, root) < 0;
+	}
+	if (unixfilesystem_sync(fs) < 0)
+		err = 1;
+	unixfilesystem_free(fs);
+	return err ? -1 : 0;
+}
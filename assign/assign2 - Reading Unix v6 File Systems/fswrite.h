@@ -0,0 +1,59 @@
+#ifndef _FSWRITE_H_
+#define _FSWRITE_H_
+
+#include "unixfilesystem.h"
+
+/**
+ * Changing a filesystem.  The disk image must have been opened for writing,
+ * blocks and inodes are allocated from the superblock's free lists (see
+ * alloc.h), and files grow through the same layouts the reading side
+ * understands: up to 8 direct blocks, then ILARG with 7 singly indirect
+ * blocks and 1 doubly indirect block.
+ *
+ * Data, indirect and directory blocks are written straight to the disk, but
+ * inodes and the superblock are only written back by unixfilesystem_sync()
+ * (or unixfilesystem_free()), so building a whole tree of files costs about
+ * one write per inode sector in the end rather than one per change.
+ *
+ * Names are up to 14 characters, without slashes.  All of these return -1 on
+ * error.
+ */
+
+/**
+ * Lays out an empty filesystem on an open disk image: a boot block, a
+ * superblock, isize blocks of inodes, and fsize - isize - 2 blocks of data,
+ * all on the free list except the one holding the root directory.  The image
+ * must hold at least fsize sectors.  Returns 0 on success.
+ */
+int fswrite_mkfs(int dfd, int fsize, int isize);
+
+/**
+ * Creates an empty regular file with the specified name and permissions in
+ * the directory with the specified inumber.  Returns the new file's inumber.
+ */
+int fswrite_create(struct unixfilesystem *fs, int dirinumber, const char *name, int mode);
+
+/**
+ * Creates an empty directory (holding only "." and "..") with the specified
+ * name and permissions in the directory with the specified inumber.  Returns
+ * the new directory's inumber.
+ */
+int fswrite_mkdir(struct unixfilesystem *fs, int dirinumber, const char *name, int mode);
+
+/**
+ * Appends length bytes from buf to the end of the file with the specified
+ * inumber.  New blocks are allocated in as long contiguous runs as the free
+ * list allows, and each run of them is written with a single system call.
+ * Returns 0 on success.
+ */
+int fswrite_append(struct unixfilesystem *fs, int inumber, const void *buf, int length);
+
+/**
+ * Removes the entry with the specified name from the directory with the
+ * specified inumber.  Once nothing refers to a file any more, its blocks and
+ * inode are freed.  Directories can only be removed when empty.  Returns 0
+ * on success.
+ */
+int fswrite_unlink(struct unixfilesystem *fs, int dirinumber, const char *name);
+
+#endif // _FSWRITE_H_
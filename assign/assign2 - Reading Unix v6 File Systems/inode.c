@@ -1,4 +1,6 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 
 #include "inode.h"
@@ -16,12 +18,20 @@ const int singleLimit = DIND * blockNumPerSector;
  */
 int inode_iget(struct unixfilesystem *fs, int inumber, struct inode *inp)
 {
+	if (inumber < 1 || inumber > fs->superblock.s_isize * inodesPerSector)
+		return -1;
+	if (fs->inodeTable != NULL)
+	{
+		memcpy(inp, fs->inodeTable + (inumber - 1) * sizeof(struct inode), sizeof(struct inode));
+		return 0;
+	}
 	inumber--; // inode starts from 1
 	int sectorNum = INODE_START_SECTOR + (inumber / inodesPerSector);
 	int sectorOffset = inumber % inodesPerSector;
 
-	struct inode inodes[inodesPerSector];
-	if (diskimg_readsector(fs->dfd, sectorNum, inodes) != DISKIMG_SECTOR_SIZE)
+	struct inode buf[inodesPerSector];
+	const struct inode *inodes = unixfilesystem_getsector(fs, sectorNum, buf);
+	if (inodes == NULL)
 	{
 		return -1;
 	}
@@ -29,6 +39,36 @@ int inode_iget(struct unixfilesystem *fs, int inumber, struct inode *inp)
 	return 0;
 }
 
+/**
+ * Stores the specified inode in the in-memory copy of the inode area (reading
+ * it in first if this is the first write) and marks its sector dirty.
+ * Returns 0 on success, -1 on error.
+ */
+int inode_iput(struct unixfilesystem *fs, int inumber, const struct inode *inp)
+{
+	int numSectors = fs->superblock.s_isize;
+	if (inumber < 1 || inumber > numSectors * inodesPerSector)
+		return -1;
+	if (fs->inodeTable == NULL)
+	{
+		uint8_t *table = malloc(numSectors * DISKIMG_SECTOR_SIZE);
+		uint8_t *dirty = calloc(numSectors, 1);
+		if (table == NULL || dirty == NULL ||
+			unixfilesystem_getsectors(fs, INODE_START_SECTOR, numSectors, table) < 0)
+		{
+			free(table);
+			free(dirty);
+			return -1;
+		}
+		fs->inodeTable = table;
+		fs->inodeDirty = dirty;
+	}
+	inumber--;
+	memcpy(fs->inodeTable + inumber * sizeof(struct inode), inp, sizeof(struct inode));
+	fs->inodeDirty[inumber / inodesPerSector] = 1;
+	return 0;
+}
+
 /**
  * Given an index of a file block, retrieves the file's actual block number
  * of from the given inode.
@@ -46,8 +86,9 @@ int inode_indexlookup(struct unixfilesystem *fs, struct inode *inp, int blockNum
 	}
 	if (blockNum < singleLimit)
 	{
-		uint16_t singleInd[blockNumPerSector];
-		if (diskimg_readsector(fs->dfd, inp->i_addr[blockNum / blockNumPerSector], singleInd) != DISKIMG_SECTOR_SIZE)
+		uint16_t buf[blockNumPerSector];
+		const uint16_t *singleInd = unixfilesystem_getsector(fs, inp->i_addr[blockNum / blockNumPerSector], buf);
+		if (singleInd == NULL)
 		{
 			return -1;
 		};
@@ -56,13 +97,14 @@ int inode_indexlookup(struct unixfilesystem *fs, struct inode *inp, int blockNum
 	else
 	{
 		blockNum -= singleLimit;
-		uint16_t singleInd[blockNumPerSector];
-		if (diskimg_readsector(fs->dfd, inp->i_addr[DIND], singleInd) != DISKIMG_SECTOR_SIZE)
+		uint16_t buf[blockNumPerSector];
+		const uint16_t *singleInd = unixfilesystem_getsector(fs, inp->i_addr[DIND], buf);
+		if (singleInd == NULL)
 		{
 			return -1;
 		};
-		uint16_t doubleInd[blockNumPerSector];
-		if (diskimg_readsector(fs->dfd, singleInd[blockNum / blockNumPerSector], doubleInd) != DISKIMG_SECTOR_SIZE)
+		const uint16_t *doubleInd = unixfilesystem_getsector(fs, singleInd[blockNum / blockNumPerSector], buf);
+		if (doubleInd == NULL)
 		{
 			return -1;
 		}
@@ -70,6 +112,48 @@ int inode_indexlookup(struct unixfilesystem *fs, struct inode *inp, int blockNum
 	}
 }
 
+/**
+ * Resolves the disk block numbers of the first numBlocks blocks of the file,
+ * reading each indirect block only once.  Returns 0 on success, -1 on error.
+ */
+int inode_blockmap(struct unixfilesystem *fs, struct inode *inp, uint16_t *blocks, int numBlocks)
+{
+	if (((inp->i_mode) & ILARG) == 0)
+	{
+		if (numBlocks > DIND + 1)
+			return -1;
+		for (int i = 0; i < numBlocks; i++)
+			blocks[i] = inp->i_addr[i];
+		return 0;
+	}
+	uint16_t buf[blockNumPerSector];
+	int count = 0;
+	for (int i = 0; i < DIND && count < numBlocks; i++)
+	{
+		const uint16_t *singleInd = unixfilesystem_getsector(fs, inp->i_addr[i], buf);
+		if (singleInd == NULL)
+			return -1;
+		for (int j = 0; j < blockNumPerSector && count < numBlocks; j++)
+			blocks[count++] = singleInd[j];
+	}
+	if (count == numBlocks)
+		return 0;
+
+	uint16_t doubleBuf[blockNumPerSector];
+	const uint16_t *doubleInd = unixfilesystem_getsector(fs, inp->i_addr[DIND], doubleBuf);
+	if (doubleInd == NULL)
+		return -1;
+	for (int i = 0; i < blockNumPerSector && count < numBlocks; i++)
+	{
+		const uint16_t *singleInd = unixfilesystem_getsector(fs, doubleInd[i], buf);
+		if (singleInd == NULL)
+			return -1;
+		for (int j = 0; j < blockNumPerSector && count < numBlocks; j++)
+			blocks[count++] = singleInd[j];
+	}
+	return count == numBlocks ? 0 : -1;
+}
+
 /**
  * Computes the size in bytes of the file identified by the given inode
  */
@@ -77,3 +161,12 @@ int inode_getsize(struct inode *inp)
 {
 	return ((inp->i_size0) << 16) + inp->i_size1;
 }
+
+/**
+ * Sets the size in bytes of the file identified by the given inode
+ */
+void inode_setsize(struct inode *inp, int size)
+{
+	inp->i_size0 = size >> 16;
+	inp->i_size1 = size & 0xffff;
+}
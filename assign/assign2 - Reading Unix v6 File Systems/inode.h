@@ -9,6 +9,13 @@
  */
 int inode_iget(struct unixfilesystem *fs, int inumber, struct inode *inp); 
 
+/**
+ * Writes the specified inode back to the filesystem.  The write is batched
+ * until the next unixfilesystem_sync() (see unixfilesystem.h), but every
+ * later inode_iget sees it immediately.  Returns 0 on success, -1 on error.
+ */
+int inode_iput(struct unixfilesystem *fs, int inumber, const struct inode *inp);
+
 /**
  * Given an index of a file block, retrieves the file's actual block number
  * of from the given inode.
@@ -17,9 +24,23 @@ int inode_iget(struct unixfilesystem *fs, int inumber, struct inode *inp);
  */
 int inode_indexlookup(struct unixfilesystem *fs, struct inode *inp, int blockNum);
 
+/**
+ * Resolves the disk block numbers of the first numBlocks blocks of the file
+ * identified by the given inode into blocks, reading each indirect block only
+ * once, rather than once per file block as repeated inode_indexlookup calls
+ * would.  Returns 0 on success, -1 on error.
+ */
+int inode_blockmap(struct unixfilesystem *fs, struct inode *inp, uint16_t *blocks, int numBlocks);
+
 /**
  * Computes the size in bytes of the file identified by the given inode
  */
 int inode_getsize(struct inode *inp);
 
+/**
+ * Sets the size in bytes of the file identified by the given inode.  Sizes
+ * are 24 bits, so size must be less than 16MB.
+ */
+void inode_setsize(struct inode *inp, int size);
+
 #endif // _INODE_
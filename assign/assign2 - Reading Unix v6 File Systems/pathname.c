@@ -1,6 +1,7 @@
 
 #include "pathname.h"
 #include "directory.h"
+#include "dircache.h"
 #include "inode.h"
 #include "diskimg.h"
 #include <stdio.h>
@@ -14,26 +15,74 @@
  * Returns the inode number associated with the specified pathname.  This need only
  * handle absolute paths.  Returns a negative number (-1 is fine) if an error is
  * encountered.
+ *
+ * The pathname is first rewritten in canonical form, remembering where each
+ * of its prefixes ends.  The longest prefix whose inumber is already in the
+ * directory cache is taken as the starting point, and only the components
+ * after it are looked up, each newly resolved prefix being added to the cache.
  */
 int pathname_lookup(struct unixfilesystem *fs, const char *pathname)
 {
-	// initialize directv6 to ROOT
-	struct direntv6 target;
-	target.d_inumber = ROOT_INUMBER;
-	// copy const char* to char* to use strtok
-	char *pName = malloc(strlen(pathname) + 1);
-	if (pName)
-		strcpy(pName, pathname);
-	// logic
-	char *p = strtok(pName, "/");
-	while (p)
+	int pathLen = strlen(pathname);
+	// "/" followed by every component and a "/" after each; one end per component
+	char *canon = malloc(pathLen + 2);
+	int *ends = malloc((pathLen / 2 + 1) * sizeof(int));
+	if (canon == NULL || ends == NULL)
 	{
-		int dirIno = target.d_inumber;
-		if (directory_findname(fs, p, dirIno, &target) < 0)
+		free(canon);
+		free(ends);
+		return -1;
+	}
+	int numComponents = 0, length = 0;
+	for (int i = 0; i < pathLen;)
+	{
+		while (i < pathLen && pathname[i] == '/')
+			i++;
+		if (i == pathLen)
+			break;
+		canon[length++] = '/';
+		while (i < pathLen && pathname[i] != '/')
+			canon[length++] = pathname[i++];
+		ends[numComponents++] = length;
+	}
+
+	// find the longest prefix that's already been resolved
+	int inumber = ROOT_INUMBER;
+	int resolved = numComponents;
+	while (resolved > 0)
+	{
+		int cached = dircache_lookuppath(fs, canon, ends[resolved - 1]);
+		if (cached >= 0)
+		{
+			inumber = cached;
+			break;
+		}
+		resolved--;
+	}
+
+	// and walk the rest of the way
+	char name[DIR_MAX_LEN + 1];
+	for (int c = resolved; c < numComponents; c++)
+	{
+		int start = (c == 0 ? 0 : ends[c - 1]) + 1;
+		int nameLen = ends[c] - start;
+		struct direntv6 target;
+		if (nameLen > DIR_MAX_LEN)
+		{
+			inumber = -1;
+			break;
+		}
+		memcpy(name, canon + start, nameLen);
+		name[nameLen] = '\0';
+		if (directory_findname(fs, name, inumber, &target) < 0)
 		{
-			return -1;
+			inumber = -1;
+			break;
 		}
-		p = strtok(NULL, "/");
+		inumber = target.d_inumber;
+		dircache_addpath(fs, canon, ends[c], inumber);
 	}
-	return target.d_inumber;
+	free(canon);
+	free(ends);
+	return inumber;
 }
@@ -0,0 +1,153 @@
+#include "treewalk.h"
+#include "directory.h"
+#include "inode.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define DIR_MAX_LEN 14
+
+/**
+ * One level of the walk: an open directory, and how long the path to it is,
+ * so the path can be cut back to it before appending the next child's name.
+ */
+struct walkframe
+{
+	struct direntiter it;
+	int pathLength;
+};
+
+struct walkstate
+{
+	char *path;
+	int pathCapacity;
+	struct walkframe **frames;
+	int numFrames;
+	int frameCapacity;
+};
+
+/**
+ * Makes room for a path of the specified length.  Returns 0 on success, -1
+ * if memory ran out.
+ */
+static int ReservePath(struct walkstate *ws, int length)
+{
+	if (length + 1 <= ws->pathCapacity)
+		return 0;
+	int capacity = ws->pathCapacity * 2;
+	while (capacity < length + 1)
+		capacity *= 2;
+	char *path = realloc(ws->path, capacity);
+	if (path == NULL)
+		return -1;
+	ws->path = path;
+	ws->pathCapacity = capacity;
+	return 0;
+}
+
+/**
+ * Visits the file whose path is currently in ws->path and, if the visitor
+ * wants it descended into and it's a directory, opens it as a new frame.
+ * Returns the visitor's negative return value to stop, -1 if memory ran out,
+ * 0 otherwise.
+ */
+static int Visit(struct unixfilesystem *fs, struct walkstate *ws, int inumber,
+				 treewalk_visitor visit, void *aux)
+{
+	struct inode in;
+	struct treewalk_entry entry;
+	entry.pathname = ws->path;
+	entry.inumber = inumber;
+	entry.parentInumber = (ws->numFrames > 0) ? ws->frames[ws->numFrames - 1]->it.dir.inumber : 0;
+	entry.in = (inode_iget(fs, inumber, &in) < 0) ? NULL : &in;
+	entry.depth = ws->numFrames;
+	int action = visit(fs, &entry, aux);
+	if (action < 0)
+		return action;
+	if (action == TREEWALK_PRUNE || entry.in == NULL || (in.i_mode & IFMT) != IFDIR)
+		return 0;
+
+	if (ws->numFrames == ws->frameCapacity)
+	{
+		int capacity = ws->frameCapacity * 2;
+		struct walkframe **frames = realloc(ws->frames, capacity * sizeof(struct walkframe *));
+		if (frames == NULL)
+			return -1;
+		ws->frames = frames;
+		ws->frameCapacity = capacity;
+	}
+	struct walkframe *frame = malloc(sizeof(struct walkframe));
+	if (frame == NULL)
+		return -1;
+	if (directory_open(fs, inumber, &frame->it) < 0)
+	{
+		free(frame);
+		return 0;
+	}
+	frame->pathLength = strlen(ws->path);
+	// children of "/" are "/name", not "//name"
+	if (frame->pathLength == 1 && ws->path[0] == '/')
+		frame->pathLength = 0;
+	ws->frames[ws->numFrames++] = frame;
+	return 0;
+}
+
+static int IsDotOrDotDot(const char *name)
+{
+	return name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'));
+}
+
+int treewalk(struct unixfilesystem *fs, const char *pathname, int inumber,
+			 treewalk_visitor visit, void *aux)
+{
+	struct walkstate ws;
+	ws.pathCapacity = 256;
+	ws.path = malloc(ws.pathCapacity);
+	ws.frameCapacity = 16;
+	ws.frames = malloc(ws.frameCapacity * sizeof(struct walkframe *));
+	ws.numFrames = 0;
+	int result = -1;
+	if (ws.path == NULL || ws.frames == NULL || ReservePath(&ws, strlen(pathname)) < 0)
+		goto done;
+	strcpy(ws.path, pathname);
+
+	result = Visit(fs, &ws, inumber, visit, aux);
+	while (result == 0 && ws.numFrames > 0)
+	{
+		struct walkframe *frame = ws.frames[ws.numFrames - 1];
+		struct direntv6 d;
+		if (directory_next(&frame->it, &d) <= 0)
+		{
+			// the end of the directory, or a block that couldn't be read
+			directory_close(&frame->it);
+			free(frame);
+			ws.numFrames--;
+			continue;
+		}
+		char name[DIR_MAX_LEN + 1];
+		int nameLength = strnlen(d.d_name, DIR_MAX_LEN);
+		memcpy(name, d.d_name, nameLength);
+		name[nameLength] = '\0';
+		if (d.d_inumber == 0 || IsDotOrDotDot(name))
+			continue;
+
+		if (ReservePath(&ws, frame->pathLength + 1 + nameLength) < 0)
+		{
+			result = -1;
+			break;
+		}
+		ws.path[frame->pathLength] = '/';
+		strcpy(ws.path + frame->pathLength + 1, name);
+		result = Visit(fs, &ws, d.d_inumber, visit, aux);
+	}
+
+done:
+	while (ws.numFrames > 0)
+	{
+		struct walkframe *frame = ws.frames[--ws.numFrames];
+		directory_close(&frame->it);
+		free(frame);
+	}
+	free(ws.frames);
+	free(ws.path);
+	return result;
+}
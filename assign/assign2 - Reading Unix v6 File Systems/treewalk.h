@@ -0,0 +1,44 @@
+#ifndef _TREEWALK_H_
+#define _TREEWALK_H_
+
+#include "unixfilesystem.h"
+
+/**
+ * Walks the directory tree below a known directory in preorder, visiting
+ * each file before anything below it and the entries of every directory in
+ * the order they're stored.  Directories are streamed a block at a time and
+ * each child is visited with the inumber from its directory entry, so nothing
+ * is ever looked up by name, and the walk needs one open directory (one
+ * block) per level of nesting no matter how large the directories are.  The
+ * "." and ".." entries and unused entries (inumber 0) are skipped.
+ */
+
+/**
+ * What a visitor returns: TREEWALK_CONTINUE to go on (descending into the
+ * file if it's a directory), TREEWALK_PRUNE to go on without descending into
+ * it, or a negative number to stop the walk.
+ */
+#define TREEWALK_CONTINUE 0
+#define TREEWALK_PRUNE    1
+
+struct treewalk_entry {
+  const char *pathname;     // Absolute path, valid only until the visitor returns.
+  int inumber;
+  int parentInumber;        // The directory holding the entry, 0 for the first visit.
+  const struct inode *in;   // NULL if the inode couldn't be read.
+  int depth;                // 0 for the directory the walk starts at.
+};
+
+typedef int (*treewalk_visitor)(struct unixfilesystem *fs, const struct treewalk_entry *entry, void *aux);
+
+/**
+ * Visits the file with the specified pathname and inumber and, if it's a
+ * directory, everything below it, passing aux along to every visit.  Returns
+ * 0 once the walk is complete, the visitor's return value if it stopped the
+ * walk, or -1 if memory ran out.  Directories that can't be read are visited
+ * but not descended into.
+ */
+int treewalk(struct unixfilesystem *fs, const char *pathname, int inumber,
+             treewalk_visitor visit, void *aux);
+
+#endif // _TREEWALK_H_
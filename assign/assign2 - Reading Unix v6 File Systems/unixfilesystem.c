@@ -1,7 +1,12 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #include "unixfilesystem.h"
 #include "diskimg.h" 
+#include "dircache.h"
 
 /**
  * Allocates and initializes a struct unixfilesystem given a filedescriptor to 
@@ -10,6 +15,10 @@
  */
 
 struct unixfilesystem *unixfilesystem_init(int dfd) {
+  return unixfilesystem_initbackend(dfd, UNIXFILESYSTEM_PREAD);
+}
+
+struct unixfilesystem *unixfilesystem_initbackend(int dfd, int backend) {
   // Validate the bootblock.  This will catch the situation where something 
   // other than a descriptor to a valid diskimg is passed in.
   uint16_t bootblock[256];
@@ -35,11 +44,109 @@ struct unixfilesystem *unixfilesystem_init(int dfd) {
   }
 
   fs->dfd = dfd;  
+  fs->image = NULL;
+  fs->imageSize = 0;
+  fs->inodeTable = NULL;
+  fs->inodeDirty = NULL;
+  fs->inodeRotor = 0;
+  fs->dircache = dircache_create();
+  if (fs->dircache == NULL) {
+    fprintf(stderr,"Out of memory.\n");
+    free(fs);
+    return NULL;
+  }
   if (diskimg_readsector(dfd, SUPERBLOCK_SECTOR, &fs->superblock) != DISKIMG_SECTOR_SIZE) {
     fprintf(stderr, "Error reading superblock\n");
+    dircache_free(fs->dircache);
     free(fs);
     return NULL;
   }
+  // s_fmod means the in-core copy has changes to write back, which this one doesn't yet
+  fs->superblock.s_fmod = 0;
+
+  if (backend == UNIXFILESYSTEM_MMAP) {
+    int size = diskimg_getsize(dfd);
+    void *image = (size > 0) ? mmap(NULL, size, PROT_READ, MAP_SHARED, dfd, 0) : MAP_FAILED;
+    if (image == MAP_FAILED) {
+      fprintf(stderr, "Error mapping the disk image\n");
+      dircache_free(fs->dircache);
+      free(fs);
+      return NULL;
+    }
+    fs->image = image;
+    fs->imageSize = size;
+  }
 
   return fs;
 }
+
+void unixfilesystem_free(struct unixfilesystem *fs) {
+  if (fs == NULL) return;
+  if (unixfilesystem_sync(fs) < 0) fprintf(stderr, "Error writing back the filesystem\n");
+  free(fs->inodeTable);
+  free(fs->inodeDirty);
+  if (fs->image != NULL) munmap(fs->image, fs->imageSize);
+  dircache_free(fs->dircache);
+  free(fs);
+}
+
+int unixfilesystem_sync(struct unixfilesystem *fs) {
+  int err = 0;
+  if (fs->inodeTable != NULL) {
+    int numSectors = fs->superblock.s_isize;
+    for (int first = 0; first < numSectors; first++) {
+      if (!fs->inodeDirty[first]) continue;
+      int last = first;
+      while (last + 1 < numSectors && fs->inodeDirty[last + 1]) last++;
+      int count = last - first + 1;
+      if (diskimg_writesectors(fs->dfd, INODE_START_SECTOR + first, count,
+                               fs->inodeTable + first * DISKIMG_SECTOR_SIZE) != count * DISKIMG_SECTOR_SIZE) {
+        err = -1;
+      } else {
+        memset(fs->inodeDirty + first, 0, count);
+      }
+      first = last;
+    }
+  }
+
+  if (fs->superblock.s_fmod) {
+    // stored the way the PDP-11 stored a long: high word first
+    time_t now = time(NULL);
+    fs->superblock.s_time[0] = (uint16_t) (now >> 16);
+    fs->superblock.s_time[1] = (uint16_t) now;
+    fs->superblock.s_fmod = 0;
+    if (diskimg_writesector(fs->dfd, SUPERBLOCK_SECTOR, &fs->superblock) != DISKIMG_SECTOR_SIZE) {
+      fs->superblock.s_fmod = 1;
+      err = -1;
+    }
+  }
+  return err;
+}
+
+const void *unixfilesystem_getsector(struct unixfilesystem *fs, int sectorNum, void *buf) {
+  if (fs->image == NULL) {
+    return (diskimg_readsector(fs->dfd, sectorNum, buf) == DISKIMG_SECTOR_SIZE) ? buf : NULL;
+  }
+  if (sectorNum < 0 || (sectorNum + 1) * DISKIMG_SECTOR_SIZE > fs->imageSize) return NULL;
+  return fs->image + sectorNum * DISKIMG_SECTOR_SIZE;
+}
+
+int unixfilesystem_getsectors(struct unixfilesystem *fs, int firstSector, int numSectors, void *buf) {
+  int length = numSectors * DISKIMG_SECTOR_SIZE;
+  if (fs->image == NULL) {
+    return (diskimg_readsectors(fs->dfd, firstSector, numSectors, buf) == length) ? 0 : -1;
+  }
+  if (firstSector < 0 || numSectors < 0 || firstSector * DISKIMG_SECTOR_SIZE + length > fs->imageSize) return -1;
+  memcpy(buf, fs->image + firstSector * DISKIMG_SECTOR_SIZE, length);
+  return 0;
+}
+
+int unixfilesystem_readahead(struct unixfilesystem *fs, int firstSector, int numSectors) {
+  if (fs->image == NULL) return diskimg_readahead(fs->dfd, firstSector, numSectors);
+  if (firstSector < 0 || (firstSector + numSectors) * DISKIMG_SECTOR_SIZE > fs->imageSize) return -1;
+  // madvise wants a page-aligned start
+  long page = sysconf(_SC_PAGESIZE);
+  long start = (long) firstSector * DISKIMG_SECTOR_SIZE;
+  long aligned = start - start % page;
+  return madvise(fs->image + aligned, start - aligned + (long) numSectors * DISKIMG_SECTOR_SIZE, MADV_WILLNEED);
+}
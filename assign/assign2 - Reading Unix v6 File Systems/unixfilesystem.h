@@ -25,11 +25,72 @@
 #define ROOT_INUMBER        1
 #define BOOTBLOCK_MAGIC_NUM 0407
 
+/**
+ * How the filesystem reads sectors from the disk image:
+ *   UNIXFILESYSTEM_PREAD  through diskimg_readsector() and its sector cache
+ *   UNIXFILESYSTEM_MMAP   straight out of a read-only mapping of the whole image,
+ *                         so sectors can be read in place without being copied
+ */
+#define UNIXFILESYSTEM_PREAD 0
+#define UNIXFILESYSTEM_MMAP  1
+
 struct unixfilesystem {
   int dfd; // Handle from the diskimg module to read the diskimg.
   struct filsys superblock;  // The superblock read from the diskimage.
+  uint8_t *image;            // The mapped image with UNIXFILESYSTEM_MMAP, NULL otherwise.
+  int imageSize;             // The size of the mapping in bytes.
+  struct dircache *dircache; // Name indexes and resolved paths (see dircache.h).
+  uint8_t *inodeTable;       // The whole inode area once an inode is written, NULL before.
+  uint8_t *inodeDirty;       // One flag per inode sector, set if it needs writing back.
+  int inodeRotor;            // Where the next scan for free inodes starts.
 };
 
+/**
+ * Allocates and initializes a struct unixfilesystem given a file descriptor
+ * to an open disk image, reading it with UNIXFILESYSTEM_PREAD.
+ * unixfilesystem_initbackend() does the same with the specified backend.
+ * Both return NULL on error.
+ */
 struct unixfilesystem *unixfilesystem_init(int fd);
+struct unixfilesystem *unixfilesystem_initbackend(int fd, int backend);
+
+/**
+ * Releases a struct unixfilesystem, including any mapping of the image, after
+ * writing back anything unixfilesystem_sync() would.  It doesn't close the
+ * disk image itself.
+ */
+void unixfilesystem_free(struct unixfilesystem *fs);
+
+/**
+ * Writes to the filesystem are batched.  The first inode written (see
+ * inode_iput) brings the entire inode area into memory, where every later
+ * inode write just marks its sector dirty, and changes to the superblock's
+ * free lists only set its s_fmod flag.  unixfilesystem_sync() writes out the
+ * dirty inode sectors, each contiguous run of them with a single write, then
+ * the superblock if s_fmod is set.  Returns 0 on success, -1 on error.
+ */
+int unixfilesystem_sync(struct unixfilesystem *fs);
+
+/**
+ * Returns the address of the contents of the specified sector, or NULL on
+ * error.  With UNIXFILESYSTEM_MMAP that's the sector itself, inside the
+ * mapped image, and buf is untouched; otherwise the sector is read into buf
+ * (which must hold DISKIMG_SECTOR_SIZE bytes) and buf is returned.  Either
+ * way the contents must be treated as read-only.
+ */
+const void *unixfilesystem_getsector(struct unixfilesystem *fs, int sectorNum, void *buf);
+
+/**
+ * Reads numSectors consecutive sectors starting at firstSector into buf: with
+ * one system call for UNIXFILESYSTEM_PREAD, or one copy out of the mapping for
+ * UNIXFILESYSTEM_MMAP.  Returns 0 on success, -1 on error.
+ */
+int unixfilesystem_getsectors(struct unixfilesystem *fs, int firstSector, int numSectors, void *buf);
+
+/**
+ * Hints that the specified run of sectors is about to be read.  Returns 0 on
+ * success, -1 on error.
+ */
+int unixfilesystem_readahead(struct unixfilesystem *fs, int firstSector, int numSectors);
 
 #endif // _UNIXFILESYSTEM_H_
@@ -26,14 +26,31 @@ def factorization(num):
     factors = map(lambda num: str(num), factors)
     return '%d = %s' % (original, ' * '.join(factors))
 
-self_halting = len(sys.argv) > 1 and sys.argv[1] == '--self-halting'
+def respond(num):
+    start = time.time()
+    response = factorization(num)
+    stop = time.time()
+    return '%s [pid: %d, time: %g seconds]' % (response, pid, stop - start)
+
 pid = os.getpid()
+
+# With --framed, each request line holds one or more "<id> <number>" pairs,
+# and each number is answered on its own line as "<id> <response>", so
+# several numbers can be queued up here at once.
+if len(sys.argv) > 1 and sys.argv[1] == '--framed':
+    while True:
+        line = sys.stdin.readline()
+        if not line: break
+        fields = line.split()
+        for id, num in zip(fields[0::2], fields[1::2]):
+            sys.stdout.write('%s %s\n' % (id, respond(int(num))))
+        sys.stdout.flush()
+    sys.exit(0)
+
+self_halting = len(sys.argv) > 1 and sys.argv[1] == '--self-halting'
 while True:
     if self_halting: os.kill(pid, signal.SIGSTOP)
     try: num = int(raw_input()) 
     except EOFError: break;
-    start = time.time()
-    response = factorization(num)
-    stop = time.time()
-    print '%s [pid: %d, time: %g seconds]' % (response, pid, stop - start)
+    print respond(num)
     
@@ -1,10 +1,16 @@
 #include <cassert>
 #include <ctime>
 #include <cctype>
+#include <cerrno>
 #include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <cstdlib>
+#include <algorithm>
+#include <deque>
+#include <string>
 #include <vector>
+#include <sys/epoll.h>
 #include <sys/wait.h>
 #include <unistd.h>
 #include <sched.h>
@@ -12,154 +18,352 @@
 
 using namespace std;
 
+/**
+ * Workers are persistent and speak a framed protocol over their supply and
+ * ingest pipes: farm writes request lines holding one or more
+ * "<id> <number>" pairs, and the worker answers each number on its own line
+ * as "<id> <factorization>".  Because every response names the number it
+ * answers, up to maxJobsInFlight numbers can be queued with each worker at
+ * once, and farm learns a worker has room for more by reading its responses
+ * (through epoll) rather than by waiting for it to stop.  Whatever input is
+ * already buffered goes out in batches of up to kMaxBatchSize numbers.
+ *
+ * Numbers are given ids in input order, and the answers are printed in that
+ * order no matter which worker finishes first: each answer waits in a ring
+ * of kReorderWindow slots, indexed by id, until every earlier one has been
+ * printed.  No number is read from stdin until its slot is free, so a slow
+ * number holds up the input rather than letting answers pile up behind it,
+ * and farm's memory stays the same however much input there is.
+ *
+ * The workers run factor.py unless farm is given --native, in which case
+ * they run native-factor, which is fast enough to be worth feeding more.
+ */
+static const char *kPythonWorkerArguments[] = {"./factor.py", "--framed", NULL};
+static const char *kNativeWorkerArguments[] = {"./native-factor", NULL};
+static const size_t kPythonMaxJobsInFlight = 4;
+static const size_t kNativeMaxJobsInFlight = 256;
+static const size_t kMaxBatchSize = 64;
+static const size_t kReorderWindow = 4096;
+
 struct worker
 {
   worker() {}
-  worker(char *argv[]) : sp(subprocess(argv, true, false)), available(false) {}
+  worker(char *argv[]) : sp(subprocess(argv, true, true)), inFlight(0), alive(true), ready(false) {}
   subprocess_t sp;
-  bool available;
+  size_t inFlight; // numbers sent but not yet answered
+  bool alive;      // false once its ingestfd reports end of file
+  bool ready;      // true while it's in readyWorkers
+  string partial;  // the start of a response line that hasn't fully arrived
 };
 
 static const size_t kNumCPUs = sysconf(_SC_NPROCESSORS_ONLN);
-// restore static keyword once you start using these, commented out to suppress compiler warning
 static vector<worker> workers(kNumCPUs);
-static size_t numWorkersAvailable = 0;
+static deque<size_t> readyWorkers; // workers with room for more numbers
+static const char **workerArguments = kPythonWorkerArguments;
+static size_t maxJobsInFlight = kPythonMaxJobsInFlight;
+static size_t numJobsInFlight = 0;
+static size_t numLiveWorkers = 0;
+static bool stopWaiting = false; // set once there's no way to hear from the workers
+static size_t nextJobId = 0;
+static int epollfd = -1;
 
-static void markWorkersAsAvailable(int sig)
+struct result
 {
-  while (true)
+  string text;  // the answer, without its id
+  size_t owner; // the worker the number went to
+  bool done;    // true once the answer is in (or the worker died without giving it)
+  bool lost;    // true if the worker died without giving it
+};
+
+static vector<result> reorderBuffer(kReorderWindow);
+static size_t nextIdToPrint = 0;
+
+static void markWorkerReady(size_t idx)
+{
+  worker &w = workers[idx];
+  if (w.alive && !w.ready && w.inFlight < maxJobsInFlight)
   {
-    pid_t pid = waitpid(-1, NULL, WNOHANG | WUNTRACED);
-    if (pid <= 0)
-      break;
-    for (size_t i = 0; i < kNumCPUs; i++)
-    {
-      if (workers[i].sp.pid == pid)
-      {
-        workers[i].available = true;
-        numWorkersAvailable++;
-        break;
-      }
-    }
+    w.ready = true;
+    readyWorkers.push_back(idx);
   }
 }
 
-// restore static keyword once you start using it, commented out to suppress compiler warning
-static const char *kWorkerArguments[] = {"./factor.py", "--self-halting", NULL};
 static void spawnAllWorkers()
 {
   cout << "There are this many CPUs: " << kNumCPUs << ", numbered 0 through " << kNumCPUs - 1 << "." << endl;
+  epollfd = epoll_create1(0);
+  if (epollfd < 0)
+  {
+    cerr << "Failed to create an epoll instance." << endl;
+    exit(1);
+  }
   for (size_t i = 0; i < kNumCPUs; i++)
   {
     cpu_set_t set;
     CPU_ZERO(&set);
     CPU_SET(i, &set);
-    workers[i] = worker(const_cast<char **>(kWorkerArguments));
+    workers[i] = worker(const_cast<char **>(workerArguments));
     sched_setaffinity(workers[i].sp.pid, sizeof(cpu_set_t), &set);
     cout << "Worker " << workers[i].sp.pid << " is set to run on CPU " << i << "." << endl;
+
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.u64 = i;
+    epoll_ctl(epollfd, EPOLL_CTL_ADD, workers[i].sp.ingestfd, &event);
+    numLiveWorkers++;
+    markWorkerReady(i);
   }
 }
 
-static void toggleSIGCHLDBlock(int how)
+static void printReadyResults()
 {
-  sigset_t mask;
-  sigemptyset(&mask);
-  sigaddset(&mask, SIGCHLD);
-  sigprocmask(how, &mask, NULL);
+  while (nextIdToPrint < nextJobId)
+  {
+    result &r = reorderBuffer[nextIdToPrint % kReorderWindow];
+    if (!r.done)
+      break;
+    if (!r.lost)
+      cout << r.text << '\n';
+    r.text.clear();
+    r.done = r.lost = false;
+    nextIdToPrint++;
+  }
 }
 
-// restore static keyword once you start using it, commented out to suppress compiler warning
-static size_t getAvailableWorker()
+static void handleResponse(size_t idx, const string &line)
 {
-  toggleSIGCHLDBlock(SIG_BLOCK);
-  sigset_t empty;
-  sigemptyset(&empty);
-  while (numWorkersAvailable == 0)
+  char *end;
+  size_t id = strtoull(line.c_str(), &end, 10);
+  result &r = reorderBuffer[id % kReorderWindow];
+  if (*end != ' ' || id < nextIdToPrint || id >= nextJobId || r.done || r.owner != idx)
   {
-    sigsuspend(&empty);
+    cerr << "Malformed response from worker " << workers[idx].sp.pid << ": " << line << endl;
+    return;
   }
-  size_t res = 0;
-  for (size_t i = 0; i < kNumCPUs; i++)
+  r.text.assign(end + 1);
+  r.done = true;
+  workers[idx].inFlight--;
+  numJobsInFlight--;
+  markWorkerReady(idx);
+  printReadyResults();
+}
+
+static void workerExited(size_t idx)
+{
+  worker &w = workers[idx];
+  epoll_ctl(epollfd, EPOLL_CTL_DEL, w.sp.ingestfd, NULL);
+  w.alive = false;
+  numLiveWorkers--;
+  if (w.inFlight > 0)
   {
-    if (workers[i].available)
+    cerr << "Worker " << w.sp.pid << " exited with " << w.inFlight << " numbers unfactored." << endl;
+    numJobsInFlight -= w.inFlight;
+    w.inFlight = 0;
+    // skip its numbers, or nothing after them would ever be printed
+    for (size_t id = nextIdToPrint; id < nextJobId; id++)
     {
-      numWorkersAvailable--;
-      workers[i].available = false;
-      res = i;
-      break;
+      result &r = reorderBuffer[id % kReorderWindow];
+      if (r.owner == idx && !r.done)
+        r.done = r.lost = true;
     }
+    printReadyResults();
   }
-  toggleSIGCHLDBlock(SIG_UNBLOCK);
-  return res;
 }
 
-static void broadcastNumbersToWorkers()
+/**
+ * Waits until at least one worker has something to say, and handles every
+ * complete response that has arrived by then.  Returns false, having said
+ * why, if there's nothing left to wait for: every worker has exited, or
+ * epoll_wait has failed.
+ */
+static bool collectResponses()
+{
+  cout.flush();
+  if (numLiveWorkers == 0 && !stopWaiting)
+  {
+    cerr << "Every worker has exited." << endl;
+    stopWaiting = true;
+  }
+  if (stopWaiting)
+    return false;
+  struct epoll_event events[16];
+  int numEvents = epoll_wait(epollfd, events, sizeof(events) / sizeof(events[0]), -1);
+  if (numEvents < 0)
+  {
+    if (errno == EINTR)
+      return true;
+    cerr << "epoll_wait failed: " << strerror(errno) << endl;
+    stopWaiting = true;
+    return false;
+  }
+  for (int e = 0; e < numEvents; e++)
+  {
+    size_t idx = events[e].data.u64;
+    char buf[4096];
+    ssize_t count = read(workers[idx].sp.ingestfd, buf, sizeof(buf));
+    if (count <= 0)
+    {
+      workerExited(idx);
+      continue;
+    }
+    string &partial = workers[idx].partial;
+    partial.append(buf, count);
+    size_t start = 0;
+    for (size_t end; (end = partial.find('\n', start)) != string::npos; start = end + 1)
+      handleResponse(idx, partial.substr(start, end - start));
+    partial.erase(0, start);
+  }
+  return true;
+}
+
+static size_t numFreeResultSlots()
+{
+  return kReorderWindow - (nextJobId - nextIdToPrint);
+}
+
+/**
+ * Finds a worker that can take more numbers, waiting for responses if every
+ * worker already has maxJobsInFlight of them or there's nowhere to keep
+ * another answer.  Returns false if there's no longer any way to get one.
+ */
+static bool getAvailableWorker(size_t &idx)
 {
   while (true)
   {
-    string line;
-    getline(cin, line);
-    if (cin.fail())
-      break;
-    size_t endpos;
-    try
+    while (readyWorkers.empty() || numFreeResultSlots() == 0)
     {
-      long long num = stoll(line, &endpos);
-      if (endpos != line.size())
-        break;
-      size_t idx = getAvailableWorker();
-      struct worker availableWorker = workers[idx];
-      kill(availableWorker.sp.pid, SIGCONT);
-      dprintf(availableWorker.sp.supplyfd, "%lld\n", num);
+      if (!collectResponses())
+        return false;
     }
-    catch (invalid_argument const &ex)
+    idx = readyWorkers.front();
+    readyWorkers.pop_front();
+    workers[idx].ready = false;
+    if (workers[idx].alive)
+      return true;
+  }
+}
+
+/**
+ * Reads the next number from stdin.  Returns false at the end of the input
+ * or at the first line that isn't a number.
+ */
+static bool readNumber(long long &num)
+{
+  string line;
+  getline(cin, line);
+  if (cin.fail())
+    return false;
+  size_t endpos;
+  try
+  {
+    num = stoll(line, &endpos);
+    return endpos == line.size();
+  }
+  catch (invalid_argument const &ex)
+  {
+    std::cout << "std::invalid_argument::what(): " << ex.what() << '\n';
+    return false;
+  }
+  catch (out_of_range const &ex)
+  {
+    std::cout << "std::out_of_range::what(): " << ex.what() << '\n';
+    return false;
+  }
+}
+
+static void addToRequest(string &request, size_t idx, long long num)
+{
+  result &r = reorderBuffer[nextJobId % kReorderWindow];
+  r.owner = idx;
+  if (!request.empty())
+    request += ' ';
+  request += to_string(nextJobId++) + " " + to_string(num);
+}
+
+/**
+ * Hands every number on stdin to the workers.  Returns false if the workers
+ * couldn't be heard from before the input ran out.
+ */
+static bool broadcastNumbersToWorkers()
+{
+  long long num;
+  while (readNumber(num))
+  {
+    size_t idx;
+    if (!getAvailableWorker(idx))
     {
-      std::cout << "std::invalid_argument::what(): " << ex.what() << '\n';
-      return;
+      cerr << "The rest of the input won't be factored." << endl;
+      return false;
     }
-    catch (out_of_range const &ex)
+    size_t room = min(min(maxJobsInFlight - workers[idx].inFlight, kMaxBatchSize), numFreeResultSlots());
+    string request;
+    addToRequest(request, idx, num);
+    size_t batchSize = 1;
+    // take along whatever numbers are already buffered, without waiting for more
+    bool more = true;
+    while (batchSize < room && cin.rdbuf()->in_avail() > 0 && (more = readNumber(num)))
     {
-      std::cout << "std::out_of_range::what(): " << ex.what() << '\n';
-      return;
+      addToRequest(request, idx, num);
+      batchSize++;
     }
+    dprintf(workers[idx].sp.supplyfd, "%s\n", request.c_str());
+    workers[idx].inFlight += batchSize;
+    numJobsInFlight += batchSize;
+    markWorkerReady(idx);
+    if (!more)
+      break;
   }
+  return true;
 }
 
-static void waitForAllWorkers()
+/**
+ * Waits for the answers still outstanding.  Returns false if the workers
+ * couldn't be heard from before they all came in.
+ */
+static bool waitForAllWorkers()
 {
-  toggleSIGCHLDBlock(SIG_BLOCK);
-  sigset_t empty;
-  sigemptyset(&empty);
-  while (numWorkersAvailable < kNumCPUs)
+  while (numJobsInFlight > 0)
   {
-    sigsuspend(&empty);
+    if (!collectResponses())
+      return false;
   }
-  toggleSIGCHLDBlock(SIG_UNBLOCK);
+  return true;
 }
 
 static void closeAllWorkers()
 {
-  signal(SIGCHLD, SIG_DFL);
+  cout.flush();
   for (size_t i = 0; i < kNumCPUs; i++)
-  {
-    struct worker availableWorker = workers[i];
-    close(availableWorker.sp.supplyfd);
-    kill(availableWorker.sp.pid, SIGCONT);
-  }
+    close(workers[i].sp.supplyfd);
   for (size_t i = 0; i < kNumCPUs; i++)
   {
     int status;
     waitpid(workers[i].sp.pid, &status, 0);
+    close(workers[i].sp.ingestfd);
     // cout << "Worker " << workers[i].sp.pid << " exited with state " << WEXITSTATUS(status) << "." << endl;
   }
+  close(epollfd);
 }
 
 int main(int argc, char *argv[])
 {
-  signal(SIGCHLD, markWorkersAsAvailable);
+  if (argc > 1 && string(argv[1]) == "--native")
+  {
+    workerArguments = kNativeWorkerArguments;
+    maxJobsInFlight = kNativeMaxJobsInFlight;
+  }
+  else if (argc > 1)
+  {
+    cerr << "Usage: " << argv[0] << " [--native]" << endl;
+    return 1;
+  }
+  // unsynchronized, cin buffers its input, so batches can be taken from what's already there
+  ios::sync_with_stdio(false);
+  // a worker that dies shouldn't take farm with it on the next write
+  signal(SIGPIPE, SIG_IGN);
   spawnAllWorkers();
-  broadcastNumbersToWorkers();
-  waitForAllWorkers();
+  bool complete = broadcastNumbersToWorkers();
+  complete = waitForAllWorkers() && complete;
   closeAllWorkers();
-  return 0;
+  return complete ? 0 : 1;
 }
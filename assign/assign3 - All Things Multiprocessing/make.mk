@@ -1,8 +1,9 @@
 pipeline_src = pipeline.c pipeline-test.c 
 subprocess_src = subprocess.cc subprocess-test.cc 
 farm_src = farm.cc subprocess.cc
+native_factor_src = native-factor.cc
 
-all: pipeline subprocess farm
+all: pipeline subprocess farm native-factor
 
 pipeline:
 	gcc $(pipeline_src) -lstdc++ -o pipeline-test 
@@ -11,4 +12,7 @@ subprocess:
 	gcc $(subprocess_src) -lstdc++ -o subprocess-test 
 
 farm:
-	gcc $(farm_src) -lstdc++ -o farm
\ No newline at end of file
+	gcc $(farm_src) -lstdc++ -o farm
+
+native-factor:
+	gcc $(native_factor_src) -O2 -lstdc++ -o native-factor
@@ -0,0 +1,225 @@
+/**
+ * File: native-factor.cc
+ * ----------------------
+ * A drop-in replacement for factor.py --framed that farm runs when given
+ * --native.  Each request line holds one or more "<id> <number>" pairs, and
+ * every number is answered on a line of its own as "<id> <factorization>",
+ * in the same format factor.py uses, and flushed as soon as it has been
+ * factored, so one hard number doesn't hold up the answers before it.
+ *
+ * Numbers are factored by trial division by 2 and the odd numbers below
+ * kTrialLimit, then Pollard's rho (Brent's variant) on whatever is left,
+ * with a deterministic Miller-Rabin test deciding when a factor is prime.
+ * All of the arithmetic is 64-bit, with products taken in 128 bits.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <sys/prctl.h>
+#include <sys/time.h>
+#include <signal.h>
+#include <unistd.h>
+
+using namespace std;
+
+typedef unsigned long long u64;
+__extension__ typedef unsigned __int128 u128;
+
+static const u64 kTrialLimit = 1000;
+
+static u64 mulmod(u64 a, u64 b, u64 m)
+{
+  return (u128)a * b % m;
+}
+
+static u64 powmod(u64 base, u64 exp, u64 m)
+{
+  u64 result = 1;
+  base %= m;
+  while (exp > 0)
+  {
+    if (exp & 1)
+      result = mulmod(result, base, m);
+    base = mulmod(base, base, m);
+    exp >>= 1;
+  }
+  return result;
+}
+
+/**
+ * Miller-Rabin with a set of bases known to be exact for every n < 2^64.
+ */
+static bool isPrime(u64 n)
+{
+  if (n < 2)
+    return false;
+  static const u64 kSmallPrimes[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37};
+  for (u64 p : kSmallPrimes)
+  {
+    if (n % p == 0)
+      return n == p;
+  }
+  u64 d = n - 1;
+  int s = 0;
+  while ((d & 1) == 0)
+  {
+    d >>= 1;
+    s++;
+  }
+  static const u64 kBases[] = {2, 325, 9375, 28178, 450775, 9780504, 1795265022};
+  for (u64 a : kBases)
+  {
+    a %= n;
+    if (a == 0)
+      continue;
+    u64 x = powmod(a, d, n);
+    if (x == 1 || x == n - 1)
+      continue;
+    bool composite = true;
+    for (int r = 1; r < s && composite; r++)
+    {
+      x = mulmod(x, x, n);
+      composite = x != n - 1;
+    }
+    if (composite)
+      return false;
+  }
+  return true;
+}
+
+static u64 gcd(u64 a, u64 b)
+{
+  while (b != 0)
+  {
+    u64 t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+/**
+ * Returns a nontrivial factor of n, which must be odd and composite.
+ */
+static u64 pollardRho(u64 n)
+{
+  for (u64 c = 1;; c++)
+  {
+    // Brent's cycle detection, taking gcds of batches of products
+    u64 y = 2, x = y, g = 1, q = 1, ys = y;
+    const u64 kBatch = 128;
+    for (u64 r = 1; g == 1; r <<= 1)
+    {
+      x = y;
+      for (u64 i = 0; i < r; i++)
+        y = (mulmod(y, y, n) + c) % n;
+      for (u64 k = 0; k < r && g == 1; k += kBatch)
+      {
+        ys = y;
+        for (u64 i = 0; i < kBatch && i < r - k; i++)
+        {
+          y = (mulmod(y, y, n) + c) % n;
+          q = mulmod(q, x > y ? x - y : y - x, n);
+        }
+        g = gcd(q, n);
+      }
+    }
+    if (g == n)
+    {
+      // the batch overshot, so step back through it one product at a time
+      do
+      {
+        ys = (mulmod(ys, ys, n) + c) % n;
+        g = gcd(x > ys ? x - ys : ys - x, n);
+      } while (g == 1);
+    }
+    if (g != n)
+      return g;
+  }
+}
+
+static void factorLarge(u64 n, vector<u64> &factors)
+{
+  if (n == 1)
+    return;
+  if (isPrime(n))
+  {
+    factors.push_back(n);
+    return;
+  }
+  u64 d = pollardRho(n);
+  factorLarge(d, factors);
+  factorLarge(n / d, factors);
+}
+
+static vector<u64> factorization(u64 n)
+{
+  vector<u64> factors;
+  for (u64 p = 2; p < kTrialLimit && p * p <= n; p += (p == 2) ? 1 : 2)
+  {
+    while (n % p == 0)
+    {
+      factors.push_back(p);
+      n /= p;
+    }
+  }
+  if (n > 1)
+    factorLarge(n, factors);
+  sort(factors.begin(), factors.end());
+  return factors;
+}
+
+static double now()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/**
+ * Prints the answer to one request, matching factor.py's output: "n = n"
+ * for 1 and primes, nothing after the "=" for numbers below 1.
+ */
+static void respond(const char *id, long long num, pid_t pid)
+{
+  double start = now();
+  vector<u64> factors;
+  if (num == 1)
+    factors.push_back(1);
+  else if (num > 1)
+    factors = factorization(num);
+  double stop = now();
+
+  printf("%s %lld = ", id, num);
+  for (size_t i = 0; i < factors.size(); i++)
+    printf("%s%llu", i == 0 ? "" : " * ", factors[i]);
+  printf(" [pid: %d, time: %g seconds]\n", pid, stop - start);
+}
+
+int main(int argc, char *argv[])
+{
+  // like factor.py, don't outlive farm
+  prctl(PR_SET_PDEATHSIG, SIGKILL);
+  pid_t pid = getpid();
+  char *line = NULL;
+  size_t capacity = 0;
+  while (getline(&line, &capacity, stdin) != -1)
+  {
+    char *cursor = line, *saveptr;
+    while (true)
+    {
+      char *id = strtok_r(cursor, " \t\n", &saveptr);
+      cursor = NULL;
+      char *number = strtok_r(NULL, " \t\n", &saveptr);
+      if (id == NULL || number == NULL)
+        break;
+      respond(id, strtoll(number, NULL, 10), pid);
+      fflush(stdout);
+    }
+  }
+  free(line);
+  return 0;
+}